@@ -0,0 +1,63 @@
+#!/bin/sh
+# Compare a headless wmpmixer with one showing a dockapp: the time until
+# it answers on its control socket, its resident set size once it has,
+# and whether X, WINGs or GTK ended up mapped into it.
+#
+# usage: contrib/bench-headless.sh [WMPMIXER] [RUNS]
+#
+# Needs a PulseAudio server and socat; the dockapp runs also need an X
+# display.  For an uninstalled build, point WMPMIXER_DOCKAPP at
+# .libs/dockapp.so.
+
+wmpmixer=${1:-wmpmixer}
+runs=${2:-5}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+now_us() {
+	echo $(($(date +%s%N) / 1000))
+}
+
+# prints: startup_us rss_kb gui_libraries
+measure() {
+	sock=$dir/sock
+	rm -f "$sock"
+	start=$(now_us)
+	"$wmpmixer" "$@" --control="$sock" 2>/dev/null &
+	pid=$!
+	until echo servers | socat - UNIX-CONNECT:"$sock" 2>/dev/null |
+		grep -q '^ok$'; do
+		if ! kill -0 $pid 2>/dev/null; then
+			echo "wmpmixer $* exited early" >&2
+			exit 1
+		fi
+		sleep 0.01
+	done
+	end=$(now_us)
+	rss=$(awk '/^VmRSS:/ { print $2 }' /proc/$pid/status)
+	libs=$(grep -c 'libgtk-3\|libX11\|libWINGs' /proc/$pid/maps)
+	kill $pid
+	wait $pid 2>/dev/null
+	echo $((end - start)) $rss $libs
+}
+
+report() {
+	name=$1
+	shift
+	: > "$dir/results"
+	for i in $(seq "$runs"); do
+		measure "$@" >> "$dir/results"
+	done
+	awk -v name="$name" '
+		{ t += $1; r += $2; l = $3 }
+		END { printf "%-10s startup %8.1f ms  rss %7d kB  " \
+			     "X/WINGs/GTK mappings %d\n",
+			     name, t / NR / 1000, r / NR, l }' "$dir/results"
+}
+
+report headless --headless
+if [ -n "$DISPLAY" ]; then
+	report dockapp
+else
+	echo "dockapp    skipped, no DISPLAY"
+fi
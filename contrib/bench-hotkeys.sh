@@ -0,0 +1,105 @@
+#!/bin/sh
+# Hold the volume hotkeys down in Xvfb and report how long it took from a
+# volume change to the server reply covering it (the volume_ack_us
+# histogram), and how many requests the held keys turned into.
+#
+# usage: contrib/bench-hotkeys.sh [WMPMIXER] [HOLDS] [SECONDS]
+#
+# Needs wmpmixer configured with --enable-stats, a PulseAudio server
+# with at least one sink, Xvfb, xset and xdotool.  For an uninstalled
+# build, point WMPMIXER_DOCKAPP at .libs/dockapp.so.
+
+wmpmixer=${1:-wmpmixer}
+holds=${2:-10}
+seconds=${3:-2}
+display=:${BENCH_DISPLAY:-97}
+dir=$(mktemp -d)
+xvfb=
+pid=
+
+cleanup() {
+	[ -n "$pid" ] && kill $pid 2>/dev/null
+	[ -n "$xvfb" ] && kill $xvfb 2>/dev/null
+	rm -rf "$dir"
+}
+trap cleanup EXIT
+
+Xvfb "$display" -nolisten tcp 2>/dev/null &
+xvfb=$!
+export DISPLAY=$display
+tries=0
+until xset q >/dev/null 2>&1; do
+	tries=$((tries + 1))
+	if [ $tries -gt 100 ]; then
+		echo "Xvfb didn't start" >&2
+		exit 1
+	fi
+	sleep 0.05
+done
+# a typical desktop: repeats start after 250 ms, then 25 a second
+xset r on
+xset r rate 250 25
+
+"$wmpmixer" --hotkeys --raise-key=F12 --lower-key=F11 \
+	--stats="$dir/stats" 2>/dev/null &
+pid=$!
+
+# the first dump means the keys are grabbed and the main loop is running
+dump() {
+	rm -f "$dir/stats"
+	kill -USR1 $pid
+	tries=0
+	until [ -s "$dir/stats" ]; do
+		if ! kill -0 $pid 2>/dev/null; then
+			echo "wmpmixer exited early" >&2
+			exit 1
+		fi
+		tries=$((tries + 1))
+		if [ $tries -gt 200 ]; then
+			echo "no statistics from wmpmixer" >&2
+			exit 1
+		fi
+		sleep 0.05
+	done
+}
+dump
+# give it time to load the devices from the server
+sleep 1
+dump
+cp "$dir/stats" "$dir/before"
+
+# alternate directions so the volume doesn't sit at either end
+for i in $(seq "$holds"); do
+	xdotool keydown F12
+	sleep "$seconds"
+	xdotool keyup F12
+	xdotool keydown F11
+	sleep "$seconds"
+	xdotool keyup F11
+done
+sleep 0.5
+dump
+
+# prints: ops_sent volume_ack_count volume_ack_sum volume_ack_max
+extract() {
+	awk '/"ops_sent"/ { gsub(/[^0-9]/, ""); ops = $0 }
+	     /"volume_ack_us"/ {
+		     split($0, f, /[:,]/)
+		     print ops, f[3] + 0, f[5] + 0, f[7] + 0
+	     }' "$1"
+}
+
+extract "$dir/before" > "$dir/results"
+extract "$dir/stats" >> "$dir/results"
+awk -v holds="$holds" -v seconds="$seconds" '
+	NR == 1 { ops = $1; n = $2; sum = $3 }
+	NR == 2 { ops = $1 - ops; n = $2 - n; sum = $3 - sum; max = $4 }
+	END { printf "%d holds of %s s each way, about %d presses\n",
+		     holds, seconds,
+		     holds * 2 * (1 + (seconds - 0.25) * 25)
+	      printf "  requests sent    %8d\n", ops
+	      printf "  acknowledged     %8d\n", n
+	      if (n > 0)
+		      printf "  change to ack    %8.2f ms mean, " \
+			     "%.2f ms max\n", sum / n / 1000, max / 1000 }' \
+	"$dir/results"
@@ -0,0 +1,119 @@
+#!/bin/sh
+# Start silent streams on a null sink and time wmpmixer muting all of
+# them one at a time, with a `select N` and a `mute` for each, against a
+# single `group-mute streams on`, through its control socket.  Each
+# prints the wall time until the server has answered every change, and
+# the operations sent and paints done, from `stats`.
+#
+# usage: contrib/bench-mute.sh [WMPMIXER] [STREAMS] [ROUNDS]
+#
+# Needs a PulseAudio server, pactl, pacat, socat and a wmpmixer
+# configured with --enable-stats.  Without an X display wmpmixer runs
+# headless, and so never paints.  For an uninstalled build, point
+# WMPMIXER_DOCKAPP at .libs/dockapp.so.
+
+wmpmixer=${1:-wmpmixer}
+streams=${2:-100}
+rounds=${3:-10}
+dir=$(mktemp -d)
+sock=$dir/sock
+
+cleanup() {
+	[ -n "$wmp" ] && kill $wmp 2>/dev/null
+	[ -n "$pids" ] && kill $pids 2>/dev/null
+	[ -n "$module" ] && pactl unload-module "$module"
+	rm -rf "$dir"
+}
+trap cleanup EXIT
+
+now_us() {
+	echo $(($(date +%s%N) / 1000))
+}
+
+send() {
+	socat - UNIX-CONNECT:"$sock" 2>/dev/null
+}
+
+# prints: ops_sent ops_done paints
+counters() {
+	echo stats | send | tr -d '",' | awk '
+		$1 == "ops_sent:" { sent = $2 }
+		$1 == "ops_done:" { done = $2 }
+		$1 == "paints:" { paints = $2 }
+		END { print sent, done, paints }'
+}
+
+# until every change sent has been answered
+settle() {
+	while :; do
+		set -- $(counters)
+		[ "$1" = "$2" ] && break
+	done
+}
+
+streams_listed() {
+	echo list | send | awk '$2 == "sink-input" { print $1 }'
+}
+
+module=$(pactl load-module module-null-sink sink_name=wmpbench) || exit 1
+
+pids=
+for i in $(seq "$streams"); do
+	pacat --playback --device=wmpbench /dev/zero &
+	pids="$pids $!"
+done
+
+if [ -n "$DISPLAY" ]; then
+	"$wmpmixer" --stats --control="$sock" 2>/dev/null &
+else
+	"$wmpmixer" --headless --stats --control="$sock" 2>/dev/null &
+fi
+wmp=$!
+
+# wait for wmpmixer to answer and to list every stream
+tries=0
+while [ $(streams_listed | wc -l) -lt "$streams" ]; do
+	tries=$((tries + 1))
+	if [ $tries -gt 500 ] || ! kill -0 $wmp 2>/dev/null; then
+		echo "wmpmixer never listed $streams streams" >&2
+		exit 1
+	fi
+	sleep 0.02
+done
+if ! echo stats | send | grep -q '^ok$'; then
+	echo "wmpmixer is not collecting statistics," \
+	     "configure it with --enable-stats" >&2
+	exit 1
+fi
+
+# prints: wall_us ops_sent paints
+measure() {
+	echo group-mute streams off | send > /dev/null
+	settle
+	sleep 0.1
+	set -- $(counters)
+	sent=$1 paints=$3
+	start=$(now_us)
+	send > /dev/null
+	settle
+	end=$(now_us)
+	# the last paint waits for wmpmixer to be idle
+	sleep 0.1
+	set -- $(counters)
+	echo $((end - start)) $(($1 - sent)) $(($3 - paints))
+}
+
+: > "$dir/one"
+: > "$dir/group"
+for i in $(seq "$rounds"); do
+	streams_listed | awk '{ print "select " $1; print "mute" }' |
+		measure >> "$dir/one"
+	echo group-mute streams on | measure >> "$dir/group"
+done
+
+for name in one group; do
+	awk -v name="$name" '
+		{ t += $1; o += $2; p += $3 }
+		END { printf "%-6s %8.2f ms  ops_sent %6.1f  paints %5.1f\n",
+			     name, t / NR / 1000, o / NR, p / NR }' "$dir/$name"
+done
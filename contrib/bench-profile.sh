@@ -0,0 +1,68 @@
+#!/bin/sh
+# Create 50 null sinks and time switching all of them between two
+# states: with one pactl call per setting, and with wmpmixer
+# --load-profile, which sends only the differences in one burst.
+#
+# usage: contrib/bench-profile.sh [WMPMIXER] [SINKS] [RUNS]
+#
+# Needs a PulseAudio server and pactl.  The profile is kept in a
+# temporary GNUstep directory, so the user's own profiles are untouched.
+
+wmpmixer=${1:-wmpmixer}
+sinks=${2:-50}
+runs=${3:-10}
+dir=$(mktemp -d)
+modules=
+
+cleanup() {
+	for m in $modules; do
+		pactl unload-module "$m"
+	done
+	rm -rf "$dir"
+}
+trap cleanup EXIT
+
+export GNUSTEP_USER_ROOT=$dir
+
+now_us() {
+	echo $(($(date +%s%N) / 1000))
+}
+
+for i in $(seq "$sinks"); do
+	m=$(pactl load-module module-null-sink sink_name=wmpbench$i) || exit 1
+	modules="$modules $m"
+done
+
+# state A: every sink at 40% and unmuted, state B: 80% and muted
+set_state() {
+	for i in $(seq "$sinks"); do
+		pactl set-sink-volume wmpbench$i "$1"
+		pactl set-sink-mute wmpbench$i "$2"
+	done
+}
+
+set_state 40% 0
+"$wmpmixer" --save-profile=wmpbench-a 2>/dev/null || {
+	echo "unable to save the profile" >&2
+	exit 1
+}
+
+: > "$dir/results"
+for i in $(seq "$runs"); do
+	start=$(now_us)
+	set_state 80% 1
+	mid=$(now_us)
+	"$wmpmixer" --load-profile=wmpbench-a 2>/dev/null || {
+		echo "unable to load the profile" >&2
+		exit 1
+	}
+	end=$(now_us)
+	echo $((mid - start)) $((end - mid)) >> "$dir/results"
+done
+
+awk -v sinks="$sinks" '
+	{ p += $1; w += $2 }
+	END { printf "%d sinks, %d runs\n", sinks, NR
+	      printf "  pactl per setting  %8.1f ms\n", p / NR / 1000
+	      printf "  --load-profile     %8.1f ms\n", w / NR / 1000 }' \
+	"$dir/results"
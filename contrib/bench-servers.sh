@@ -0,0 +1,108 @@
+#!/bin/sh
+# Start N private PulseAudio daemons, each with a null sink, connect one
+# headless wmpmixer to all of them and check `servers` and `list` over
+# its control socket: the time until every server is ready and listed,
+# then that a daemon which is killed drops out and is reconnected once it
+# is started again.
+#
+# usage: contrib/bench-servers.sh [WMPMIXER] [SERVERS]
+#
+# Needs pulseaudio and socat.  For an uninstalled build, point
+# WMPMIXER_DOCKAPP at .libs/dockapp.so.
+
+wmpmixer=${1:-wmpmixer}
+count=${2:-4}
+dir=$(mktemp -d)
+sock=$dir/sock
+
+cleanup() {
+	[ -n "$wmp" ] && kill $wmp 2>/dev/null
+	for pid in $dir/*.pid; do
+		[ -f "$pid" ] && kill $(cat "$pid") 2>/dev/null
+	done
+	rm -rf "$dir"
+}
+trap cleanup EXIT
+
+now_us() {
+	echo $(($(date +%s%N) / 1000))
+}
+
+send() {
+	socat - UNIX-CONNECT:"$sock" 2>/dev/null
+}
+
+# each daemon gets its own runtime directory, so they don't find each
+# other's pid file
+start_daemon() {
+	mkdir -p "$dir/$1"
+	XDG_RUNTIME_DIR=$dir/$1 HOME=$dir/$1 \
+		pulseaudio -n --daemonize=no --exit-idle-time=-1 \
+		--use-pid-file=no \
+		--load="module-native-protocol-unix socket=$dir/$1.socket" \
+		--load="module-null-sink sink_name=bench$1" \
+		2>/dev/null &
+	echo $! > "$dir/$1.pid"
+}
+
+# prints: ready_servers listed_sinks
+check() {
+	ready=$(echo servers | send | awk '$2 == "ready"' | wc -l)
+	sinks=$(echo list | send | awk '$2 == "sink" && $6 ~ /^bench/' |
+		wc -l)
+	echo $ready $sinks
+}
+
+# waits for check to print the given state, and prints the time it took
+wait_for() {
+	start=$(now_us)
+	tries=0
+	until [ "$(check)" = "$*" ]; do
+		tries=$((tries + 1))
+		if [ $tries -gt 3000 ] || ! kill -0 $wmp 2>/dev/null; then
+			echo "gave up waiting for $* ready servers and" \
+			     "sinks, got $(check)" >&2
+			exit 1
+		fi
+		sleep 0.01
+	done
+	echo $(($(now_us) - start))
+}
+
+servers=
+for i in $(seq "$count"); do
+	start_daemon $i
+	servers="$servers --server=unix:$dir/$i.socket"
+done
+# wmpmixer gives up on a server that isn't listening yet until its
+# first retry, so give the daemons time to start
+for i in $(seq "$count"); do
+	tries=0
+	until [ -S "$dir/$i.socket" ]; do
+		tries=$((tries + 1))
+		if [ $tries -gt 500 ]; then
+			echo "pulseaudio $i never started" >&2
+			exit 1
+		fi
+		sleep 0.01
+	done
+done
+
+start=$(now_us)
+"$wmpmixer" --headless --control="$sock" $servers 2>/dev/null &
+wmp=$!
+until echo servers | send | grep -q '^ok$'; do
+	sleep 0.01
+done
+wait_for $count $count > /dev/null || exit 1
+echo "$count servers ready and listed" \
+     "$((($(now_us) - start) / 1000)) ms after startup"
+
+kill $(cat "$dir/1.pid")
+wait $(cat "$dir/1.pid") 2>/dev/null
+t=$(wait_for $((count - 1)) $((count - 1))) || exit 1
+echo "server 1 killed, dropped after $((t / 1000)) ms"
+
+start_daemon 1
+t=$(wait_for $count $count) || exit 1
+echo "server 1 restarted, reconnected after $((t / 1000)) ms"
@@ -0,0 +1,65 @@
+#!/bin/sh
+# Build wmpmixer with and without --enable-stats and replay the same
+# trace with each, to check that the instrumentation costs nothing when
+# it's compiled out, and to see what it costs when it's collecting.
+#
+# usage: contrib/bench-stats.sh TRACE [RUNS]
+#
+# TRACE is a trace recorded with --record.  Replaying needs an X display
+# (e.g. Xvfb) but no PulseAudio server.  The builds need everything
+# wmpmixer itself does, plus autoconf, automake and libtool if the
+# source tree has no configure script yet.
+
+if [ -z "$1" ]; then
+	echo "usage: $0 TRACE [RUNS]" >&2
+	exit 1
+fi
+trace=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+runs=${2:-10}
+srcdir=$(cd "$(dirname "$0")/.." && pwd)
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+if [ ! -x "$srcdir/configure" ]; then
+	(cd "$srcdir" && autoreconf -i) || exit 1
+fi
+
+build() {
+	mkdir "$dir/$1"
+	(cd "$dir/$1" && "$srcdir/configure" --quiet $2 && make -s) \
+		>/dev/null || {
+		echo "unable to build with '$2'" >&2
+		exit 1
+	}
+}
+
+build plain ""
+build stats --enable-stats
+
+# prints the milliseconds the replay took, as wmpmixer reports them
+replay() {
+	build=$dir/$1
+	shift
+	WMPMIXER_DOCKAPP=$build/.libs/dockapp.so \
+		"$build/wmpmixer" --replay="$trace" "$@" 2>&1 >/dev/null |
+		awk '/^replayed / { print $5 }'
+}
+
+# interleaved, so drift in the machine's load hits every build alike
+: > "$dir/results"
+for i in $(seq "$runs"); do
+	echo $(replay plain) $(replay stats) \
+		$(replay stats --stats="$dir/dump") >> "$dir/results"
+done
+
+awk -v runs="$runs" '
+	NF == 3 { a += $1; b += $2; c += $3; n++ }
+	END { if (n < runs) {
+		      print "some replays failed" > "/dev/stderr"
+		      exit 1
+	      }
+	      printf "%d replays each\n", n
+	      printf "  without --enable-stats     %9.3f ms\n", a / n
+	      printf "  with it, not collecting    %9.3f ms\n", b / n
+	      printf "  with it, collecting        %9.3f ms\n", c / n }' \
+	"$dir/results"
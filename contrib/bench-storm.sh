@@ -0,0 +1,83 @@
+#!/bin/sh
+# Send wmpmixer a storm of volume changes over its control socket, RATE a
+# second alternating `volume +1` and `volume -1` on one device, and
+# report the paints the frame limit saved, from `stats`.
+#
+# usage: contrib/bench-storm.sh [WMPMIXER] [RATE] [SECONDS] [DEVICE]
+#
+# Needs a PulseAudio server, an X display, socat and a wmpmixer
+# configured with --enable-stats.  For an uninstalled build, point
+# WMPMIXER_DOCKAPP at .libs/dockapp.so.
+
+wmpmixer=${1:-wmpmixer}
+rate=${2:-1000}
+seconds=${3:-10}
+device=${4:-0}
+dir=$(mktemp -d)
+sock=$dir/sock
+
+cleanup() {
+	[ -n "$wmp" ] && kill $wmp 2>/dev/null
+	rm -rf "$dir"
+}
+trap cleanup EXIT
+
+if [ -z "$DISPLAY" ]; then
+	echo "no DISPLAY, and a headless wmpmixer never paints" >&2
+	exit 1
+fi
+
+send() {
+	socat - UNIX-CONNECT:"$sock" 2>/dev/null
+}
+
+# prints: paint_requests paints paints_saved_per_second
+counters() {
+	echo stats | send | tr -d '",' | awk '
+		$1 == "paint_requests:" { requests = $2 }
+		$1 == "paints:" { paints = $2 }
+		$1 == "paints_saved_per_second:" { saved = $2 }
+		END { print requests, paints, saved }'
+}
+
+"$wmpmixer" --stats --control="$sock" 2>/dev/null &
+wmp=$!
+
+tries=0
+until echo select "$device" | send | grep -q '^ok$'; do
+	tries=$((tries + 1))
+	if [ $tries -gt 500 ] || ! kill -0 $wmp 2>/dev/null; then
+		echo "wmpmixer never had a device $device" >&2
+		exit 1
+	fi
+	sleep 0.02
+done
+if ! echo stats | send | grep -q '^ok$'; then
+	echo "wmpmixer is not collecting statistics," \
+	     "configure it with --enable-stats" >&2
+	exit 1
+fi
+
+# one burst a second, as an even stream of commands would be faster than
+# socat can be started
+awk -v n="$rate" 'BEGIN {
+	for (i = 0; i < n; i++)
+		print (i % 2 ? "volume -1" : "volume +1") }' > "$dir/burst"
+
+set -- $(counters)
+requests=$1 paints=$2
+for i in $(seq "$seconds"); do
+	next=$(($(date +%s%N) + 1000000000))
+	send < "$dir/burst" > /dev/null
+	now=$(date +%s%N)
+	[ $now -lt $next ] &&
+		sleep $(echo $next $now | awk '{ print ($1 - $2) / 1e9 }')
+done
+# the last paint waits for wmpmixer to be idle
+sleep 0.1
+set -- $(counters)
+
+echo $(($1 - requests)) $(($2 - paints)) $3 $seconds | awk '{
+	printf "paint requests %d  paints %d  " \
+	       "paints saved/s %.1f during the storm, %.1f since startup\n",
+	       $1, $2, ($1 - $2) / $4, $3 }'
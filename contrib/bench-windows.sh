@@ -0,0 +1,73 @@
+#!/bin/sh
+# Compare the memory of one wmpmixer showing three windows with three
+# wmpmixer processes showing one each.  PSS splits shared libraries
+# between the processes mapping them, so its sum is what the three
+# really cost; RSS counts the libraries once per process.
+#
+# usage: contrib/bench-windows.sh [WMPMIXER]
+#
+# Needs a PulseAudio server, socat and an X display (e.g. Xvfb).  For an
+# uninstalled build, point WMPMIXER_DOCKAPP at .libs/dockapp.so.
+
+wmpmixer=${1:-wmpmixer}
+filters="sinks sources apps"
+dir=$(mktemp -d)
+pids=
+n=0
+
+cleanup() {
+	[ -n "$pids" ] && kill $pids 2>/dev/null
+	rm -rf "$dir"
+}
+trap cleanup EXIT
+
+if [ -z "$DISPLAY" ]; then
+	echo "no DISPLAY" >&2
+	exit 1
+fi
+
+# start wmpmixer with the given options and wait until it answers
+start() {
+	n=$((n + 1))
+	sock=$dir/sock$n
+	"$wmpmixer" "$@" --control="$sock" 2>/dev/null &
+	pid=$!
+	pids="$pids $pid"
+	until echo servers | socat - UNIX-CONNECT:"$sock" 2>/dev/null |
+		grep -q '^ok$'; do
+		if ! kill -0 $pid 2>/dev/null; then
+			echo "wmpmixer $* exited early" >&2
+			exit 1
+		fi
+		sleep 0.01
+	done
+}
+
+# prints: pss_kb rss_kb, summed over the running processes
+measure() {
+	# let the devices load and the icons get drawn
+	sleep 1
+	for pid in $pids; do
+		awk '/^Pss:/ { pss = $2 } /^Rss:/ { rss = $2 }
+		     END { print pss, rss }' /proc/$pid/smaps_rollup
+	done | awk '{ pss += $1; rss += $2 } END { print pss, rss }'
+}
+
+report() {
+	printf "%-20s pss %7d kB  rss %7d kB\n" "$1" $2 $3
+}
+
+args=
+for f in $filters; do
+	args="$args --window=$f"
+done
+start $args
+report "one process" $(measure)
+kill $pids
+wait 2>/dev/null
+pids=
+
+for f in $filters; do
+	start --window=$f
+done
+report "three processes" $(measure)
@@ -0,0 +1,652 @@
+/* wmpmixer - PulseAudio mixer as a Window Maker dockapp
+ * Copyright (C) 2021 Doug Torrance <dtorrance@piedmont.edu>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include "control.h"
+#include "profile.h"
+#include "pulse.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pulse/context.h>
+#include <pulse/mainloop-api.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <WINGs/WUtil.h>
+
+/* A line-based protocol on a Unix socket: each command gets zero or more
+ * lines of output followed by "ok" or "error: <reason>". */
+
+#define CONTROL_LINE_MAX 256
+/* how long a long reply waits for a client that isn't reading */
+#define CONTROL_SEND_TIMEOUT 1000
+
+typedef struct {
+	int fd;
+	pa_io_event *event;
+	char line[CONTROL_LINE_MAX];
+	size_t len;
+} ControlClient;
+
+typedef struct {
+	const char *name;
+	const char *usage;
+	Bool needs_device;
+	void (*handler)(ControlClient *client, char *args);
+} ControlCommand;
+
+pa_mainloop_api *control_api;
+/* the device the socket's commands act on, picked independently of what
+   the dockapps show */
+PulseSelection *control_selection;
+/* clients waiting for a profile to be restored, once per load-profile,
+   so one that hangs up first isn't answered */
+WMArray *loading_clients;
+
+const char *control_type_names[] = {
+	"sink",
+	"source",
+	"sink-input",
+	"source-output"
+};
+
+void accept_cb(pa_mainloop_api *api, pa_io_event *event, int fd,
+	       pa_io_event_flags_t flags, void *userdata);
+void client_cb(pa_mainloop_api *api, pa_io_event *event, int fd,
+	       pa_io_event_flags_t flags, void *userdata);
+void close_client(ControlClient *client);
+Bool socket_in_use(struct sockaddr_un *addr);
+Bool set_nonblocking(int fd);
+void reply(ControlClient *client, const char *format, ...)
+	__attribute__((format(printf, 2, 3)));
+Bool send_all(ControlClient *client, const char *buf, size_t len);
+void run_command(ControlClient *client, char *line);
+Bool parse_int(const char *str, int *n);
+void command_help(ControlClient *client, char *args);
+void command_list(ControlClient *client, char *args);
+void command_servers(ControlClient *client, char *args);
+const char *server_state(PulseServer *server);
+void command_select(ControlClient *client, char *args);
+void command_volume(ControlClient *client, char *args);
+void command_mute(ControlClient *client, char *args);
+void command_solo(ControlClient *client, char *args);
+void command_group_mute(ControlClient *client, char *args);
+void command_group_volume(ControlClient *client, char *args);
+void command_save_profile(ControlClient *client, char *args);
+void command_load_profile(ControlClient *client, char *args);
+void load_done(Bool ok, void *data);
+void command_stats(ControlClient *client, char *args);
+
+ControlCommand control_commands[] = {
+	{"help", "", False, command_help},
+	{"list", "", False, command_list},
+	{"servers", "", False, command_servers},
+	{"select", "N", True, command_select},
+	{"volume", "N | +N | -N", True, command_volume},
+	{"mute", "", True, command_mute},
+	{"solo", "", True, command_solo},
+	{"group-mute", "GROUP on|off", False, command_group_mute},
+	{"group-volume", "GROUP +N | -N", False, command_group_volume},
+	{"save-profile", "NAME", False, command_save_profile},
+	{"load-profile", "NAME", False, command_load_profile},
+	{"stats", "", False, command_stats},
+	{NULL, NULL, False, NULL}
+};
+
+char *get_default_control_path(void)
+{
+	char *path;
+	const char *dir;
+	size_t size;
+
+	dir = getenv("XDG_RUNTIME_DIR");
+	if (dir && *dir)
+		return wstrconcat(dir, "/" PACKAGE_NAME ".sock");
+
+	size = sizeof("/tmp/" PACKAGE_NAME "-.sock") + 20;
+	path = wmalloc(size);
+	snprintf(path, size, "/tmp/" PACKAGE_NAME "-%lu.sock",
+		 (unsigned long)getuid());
+
+	return path;
+}
+
+void setup_control(const char *path)
+{
+	int fd;
+	mode_t mask;
+	struct stat st;
+	struct sockaddr_un addr;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		werror("control socket path %s is too long", path);
+		exit(EXIT_FAILURE);
+	}
+	control_selection = create_selection("all");
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || !set_nonblocking(fd)) {
+		wsyserror("unable to create control socket");
+		exit(EXIT_FAILURE);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	/* only replace a socket left behind by an earlier run */
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			werror("%s exists and is not a socket", path);
+			exit(EXIT_FAILURE);
+		}
+		if (socket_in_use(&addr)) {
+			werror("another %s is already listening on %s",
+			       PACKAGE_NAME, path);
+			exit(EXIT_FAILURE);
+		}
+		unlink(path);
+	}
+
+	/* only the owner may control the mixer */
+	mask = umask(0077);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    listen(fd, 4) < 0) {
+		wsyserror("unable to listen on %s", path);
+		exit(EXIT_FAILURE);
+	}
+	umask(mask);
+
+	control_api = get_pulse_mainloop_api();
+	control_api->io_new(control_api, fd, PA_IO_EVENT_INPUT, accept_cb,
+			    NULL);
+}
+
+/* a stale socket refuses the connection */
+Bool socket_in_use(struct sockaddr_un *addr)
+{
+	int fd;
+	Bool in_use;
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return False;
+
+	in_use = connect(fd, (struct sockaddr *)addr, sizeof(*addr)) == 0 ||
+		(errno != ECONNREFUSED && errno != ENOENT);
+	close(fd);
+
+	return in_use;
+}
+
+Bool set_nonblocking(int fd)
+{
+	return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == 0 &&
+		fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+}
+
+void accept_cb(pa_mainloop_api *api, pa_io_event *event, int fd,
+	       pa_io_event_flags_t flags, void *userdata)
+{
+	int client_fd;
+	ControlClient *client;
+
+	(void)event;
+	(void)flags;
+	(void)userdata;
+
+	client_fd = accept(fd, NULL, NULL);
+	if (client_fd < 0) {
+		if (errno != EAGAIN && errno != EINTR)
+			wsyserror("unable to accept control connection");
+		return;
+	}
+	if (!set_nonblocking(client_fd)) {
+		close(client_fd);
+		return;
+	}
+
+	client = wmalloc(sizeof(ControlClient));
+	STATS_COUNT(STAT_ALLOCATIONS);
+	client->fd = client_fd;
+	client->len = 0;
+	client->event = api->io_new(api, client_fd, PA_IO_EVENT_INPUT,
+				    client_cb, client);
+}
+
+void close_client(ControlClient *client)
+{
+	if (loading_clients)
+		WMRemoveFromArray(loading_clients, client);
+	control_api->io_free(client->event);
+	close(client->fd);
+	wfree(client);
+}
+
+void client_cb(pa_mainloop_api *api, pa_io_event *event, int fd,
+	       pa_io_event_flags_t flags, void *userdata)
+{
+	ssize_t n;
+	char *newline;
+	ControlClient *client;
+
+	(void)api;
+	(void)event;
+
+	client = userdata;
+	if (flags & (PA_IO_EVENT_HANGUP | PA_IO_EVENT_ERROR)) {
+		close_client(client);
+		return;
+	}
+
+	n = read(fd, client->line + client->len,
+		 sizeof(client->line) - client->len - 1);
+	if (n < 0 && (errno == EAGAIN || errno == EINTR))
+		return;
+	if (n <= 0) {
+		close_client(client);
+		return;
+	}
+
+	client->len += n;
+	client->line[client->len] = '\0';
+	while ((newline = strchr(client->line, '\n'))) {
+		*newline = '\0';
+		trace_command(client->line);
+		run_command(client, client->line);
+		client->len -= newline + 1 - client->line;
+		memmove(client->line, newline + 1, client->len + 1);
+	}
+
+	if (client->len == sizeof(client->line) - 1) {
+		reply(client, "error: line too long");
+		close_client(client);
+	}
+}
+
+/* replies are short, so a client that won't read them just loses them */
+void reply(ControlClient *client, const char *format, ...)
+{
+	int len;
+	char buf[CONTROL_LINE_MAX];
+	va_list args;
+
+	/* replayed commands have nobody to answer */
+	if (!client)
+		return;
+
+	va_start(args, format);
+	len = vsnprintf(buf, sizeof(buf) - 1, format, args);
+	va_end(args);
+
+	if (len < 0)
+		return;
+	if (len > (int)sizeof(buf) - 2)
+		len = sizeof(buf) - 2;
+	buf[len++] = '\n';
+
+	if (send(client->fd, buf, len, MSG_NOSIGNAL) < 0 && errno != EAGAIN)
+		wsyserror("unable to reply on control socket");
+}
+
+/* for replies too long to drop, such as the statistics */
+Bool send_all(ControlClient *client, const char *buf, size_t len)
+{
+	ssize_t n;
+	struct pollfd pfd;
+
+	pfd.fd = client->fd;
+	pfd.events = POLLOUT;
+	while (len > 0) {
+		n = send(client->fd, buf, len, MSG_NOSIGNAL);
+		if (n < 0 && errno == EAGAIN) {
+			if (poll(&pfd, 1, CONTROL_SEND_TIMEOUT) <= 0)
+				return False;
+			continue;
+		}
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			wsyserror("unable to reply on control socket");
+			return False;
+		}
+		buf += n;
+		len -= n;
+	}
+
+	return True;
+}
+
+void run_command(ControlClient *client, char *line)
+{
+	int i;
+	char *name, *args;
+
+	name = strtok_r(line, " \t\r", &args);
+	if (!name)
+		return;
+	args += strspn(args, " \t\r");
+
+	for (i = 0; control_commands[i].name; i++) {
+		if (strcmp(control_commands[i].name, name) != 0)
+			continue;
+
+		if (control_commands[i].needs_device &&
+		    !get_selected_device(control_selection)) {
+			reply(client, "error: no devices");
+			return;
+		}
+
+		control_commands[i].handler(client, args);
+		return;
+	}
+
+	reply(client, "error: unknown command '%s', try 'help'", name);
+}
+
+/* a replay has no socket, so its commands act on a selection of their
+   own, as they did in the recorded run */
+void replay_command(const char *line)
+{
+	char buf[CONTROL_LINE_MAX], *name, *args;
+
+	if (!control_selection)
+		control_selection = create_selection("all");
+
+	strncpy(buf, line, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = '\0';
+
+	/* replaying must not overwrite the user's profiles */
+	name = buf + strspn(buf, " \t\r");
+	args = name + strcspn(name, " \t\r");
+	if (args - name == strlen("save-profile") &&
+	    strncmp(name, "save-profile", args - name) == 0)
+		return;
+
+	run_command(NULL, buf);
+}
+
+Bool parse_int(const char *str, int *n)
+{
+	char *end;
+	long value;
+
+	errno = 0;
+	value = strtol(str, &end, 10);
+	if (errno || end == str || *end)
+		return False;
+
+	*n = value;
+	return True;
+}
+
+void command_help(ControlClient *client, char *args)
+{
+	int i;
+
+	(void)args;
+
+	for (i = 0; control_commands[i].name; i++)
+		reply(client, "%s%s%s", control_commands[i].name,
+		      *control_commands[i].usage ? " " : "",
+		      control_commands[i].usage);
+	reply(client, "ok");
+}
+
+/* one line per device: position, type, volume (0-25), muted, server,
+   name */
+void command_list(ControlClient *client, char *args)
+{
+	int i;
+	WMArray *devices;
+	PulseDevice *device;
+
+	(void)args;
+
+	devices = get_devices();
+	for (i = 0; i < WMGetArrayItemCount(devices); i++) {
+		device = WMGetFromArray(devices, i);
+		reply(client, "%d %s %d %s %d %s", i,
+		      control_type_names[device->type],
+		      volume_to_int(device->volume),
+		      device->muted ? "muted" : "unmuted",
+		      device->server->number, device->name);
+	}
+	reply(client, "ok");
+}
+
+/* one line per server: number, state, address */
+void command_servers(ControlClient *client, char *args)
+{
+	int i;
+	PulseServer *server;
+
+	(void)args;
+
+	for (i = 0; i < get_pulse_server_count(); i++) {
+		server = get_pulse_server(i);
+		reply(client, "%d %s %s", i, server_state(server),
+		      get_server_name(server));
+	}
+	reply(client, "ok");
+}
+
+/* a replayed server has no context, only what the trace said of it */
+const char *server_state(PulseServer *server)
+{
+	if (!server->ctx)
+		return server->lost ? "failed" :
+			server->loaded ? "ready" : "connecting";
+
+	switch (pa_context_get_state(server->ctx)) {
+	case PA_CONTEXT_READY:
+		return "ready";
+
+	case PA_CONTEXT_FAILED:
+	case PA_CONTEXT_TERMINATED:
+		return "failed";
+
+	default:
+		return "connecting";
+	}
+}
+
+void command_select(ControlClient *client, char *args)
+{
+	int n;
+
+	if (!parse_int(args, &n) || !select_device(control_selection, n)) {
+		reply(client, "error: no device '%s'", args);
+		return;
+	}
+
+	reply(client, "ok");
+}
+
+void command_volume(ControlClient *client, char *args)
+{
+	int n;
+	PulseDevice *device;
+
+	if (!parse_int(args, &n)) {
+		reply(client, "error: bad volume '%s'", args);
+		return;
+	}
+
+	device = get_selected_device(control_selection);
+	if (args[0] == '+' || args[0] == '-') {
+		change_device_volume_by(device, n);
+	} else if (n < 0 || n > 25) {
+		reply(client, "error: volume must be between 0 and 25");
+		return;
+	} else {
+		set_device_volume(device, n);
+	}
+
+	reply(client, "ok");
+}
+
+void command_mute(ControlClient *client, char *args)
+{
+	(void)args;
+
+	toggle_device_muted(get_selected_device(control_selection));
+	reply(client, "ok");
+}
+
+void command_solo(ControlClient *client, char *args)
+{
+	(void)args;
+
+	solo_device(get_selected_device(control_selection));
+	reply(client, "ok");
+}
+
+void command_group_mute(ControlClient *client, char *args)
+{
+	char *group, *state;
+	unsigned int mask;
+
+	group = strtok_r(args, " \t", &state);
+	if (!group || !(mask = get_group(group))) {
+		reply(client, "error: unknown group");
+		return;
+	}
+
+	state += strspn(state, " \t");
+	if (strcmp(state, "on") == 0) {
+		mute_group(mask, True);
+	} else if (strcmp(state, "off") == 0) {
+		mute_group(mask, False);
+	} else {
+		reply(client, "error: expected 'on' or 'off'");
+		return;
+	}
+
+	reply(client, "ok");
+}
+
+void command_group_volume(ControlClient *client, char *args)
+{
+	int n;
+	char *group, *step;
+	unsigned int mask;
+
+	group = strtok_r(args, " \t", &step);
+	if (!group || !(mask = get_group(group))) {
+		reply(client, "error: unknown group");
+		return;
+	}
+
+	step += strspn(step, " \t");
+	if (!parse_int(step, &n)) {
+		reply(client, "error: bad step '%s'", step);
+		return;
+	}
+
+	change_group_volume_by(mask, n);
+	reply(client, "ok");
+}
+
+void command_save_profile(ControlClient *client, char *args)
+{
+	if (!*args) {
+		reply(client, "error: missing profile name");
+		return;
+	}
+
+	if (save_profile(args))
+		reply(client, "ok");
+	else
+		reply(client, "error: unable to save profile '%s'", args);
+}
+
+void command_load_profile(ControlClient *client, char *args)
+{
+	if (!*args) {
+		reply(client, "error: missing profile name");
+		return;
+	}
+
+	/* answered by load_done() once the server has, which is at once
+	   if there is nothing to change */
+	if (!loading_clients)
+		loading_clients = WMCreateArray(0);
+	if (client)
+		WMAddToArray(loading_clients, client);
+	if (load_profile(args, client ? load_done : NULL, client))
+		return;
+
+	if (client)
+		WMDeleteFromArray(loading_clients,
+				  WMGetArrayItemCount(loading_clients) - 1);
+	reply(client, "error: no profile named '%s'", args);
+}
+
+void load_done(Bool ok, void *data)
+{
+	int n;
+
+	n = WMGetFirstInArray(loading_clients, data);
+	if (n == WANotFound)
+		return;
+	WMDeleteFromArray(loading_clients, n);
+
+	if (ok)
+		reply(data, "ok");
+	else
+		reply(data, "error: some of the profile couldn't be restored");
+}
+
+void command_stats(ControlClient *client, char *args)
+{
+	char *buf;
+	size_t len;
+	FILE *fp;
+
+	(void)args;
+
+	if (!stats_available()) {
+		reply(client, "error: statistics are not being collected, "
+		      "start with --stats");
+		return;
+	}
+	if (!client)
+		return;
+
+	fp = open_memstream(&buf, &len);
+	if (!fp) {
+		reply(client, "error: out of memory");
+		return;
+	}
+	write_stats(fp);
+	fclose(fp);
+
+	if (send_all(client, buf, len))
+		reply(client, "ok");
+	free(buf);
+}
@@ -0,0 +1,765 @@
+/* wmpmixer - PulseAudio mixer as a Window Maker dockapp
+ * Copyright (C) 2021 Doug Torrance <dtorrance@piedmont.edu>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib-object.h>
+#include <gtk/gtk.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <WINGs/WINGs.h>
+#include <WINGs/WUtil.h>
+#include <wraster.h>
+#include <X11/extensions/shape.h>
+#include <X11/extensions/shapeconst.h>
+#include <X11/X.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "control.h"
+#include "dockapp.h"
+#include "hotkeys.h"
+#include "monitor.h"
+#include "pulse.h"
+#include "replay.h"
+#include "stats.h"
+#include "trace.h"
+#include "wmpmixer.h"
+
+#define MARGIN 4
+#define PADDING 5
+#define DOCKAPP_MEASURE 64
+#define ICON_MEASURE 22
+#define BUTTON_Y MARGIN + ICON_MEASURE + 2 + PADDING
+#define BUTTON_MEASURE 13
+#define SLIDER_WIDTH 25
+#define SLIDER_HEIGHT ICON_MEASURE + 2 + PADDING + 2 * BUTTON_MEASURE
+#define SLIDER_X MARGIN + 2 * BUTTON_MEASURE + PADDING
+
+/* what needs repainting at the next frame */
+#define DIRTY_ICON (1 << 0)
+#define DIRTY_MUTED (1 << 1)
+#define DIRTY_SLIDER (1 << 2)
+#define DIRTY_ALL (DIRTY_ICON | DIRTY_MUTED | DIRTY_SLIDER)
+
+/* one dockapp window, showing the devices its selection matches */
+struct Dockapp {
+	int number;
+	PulseSelection *selection;
+	WMLabel *icon_label, *slider_label;
+	WMButton *mute_button;
+	unsigned int dirty;
+};
+
+WMScreen *screen;
+WMArray *dockapps;
+RColor slider_color[25];
+char stats_text[16] = "";
+/* text drawn over the icon, and over the worst devices' icons */
+WMColor *text_color, *flag_color;
+WMHashTable *icon_cache = NULL;
+/* the pending paint, run from an idle handler or a timer */
+WMHandlerID paint_handler = NULL;
+Bool paint_when_idle;
+uint64_t last_paint = 0;
+
+static char * left_xpm[] = {
+	"4 7 2 1",
+	" 	c #AEAAAE",
+	".	c #000000",
+	"   .",
+	"  ..",
+	" ...",
+	"....",
+	" ...",
+	"  ..",
+	"   ."};
+
+static char * right_xpm[] = {
+	"4 7 2 1",
+	" 	c #000000",
+	".	c #AEAAAE",
+	" ...",
+	"  ..",
+	"   .",
+	"    ",
+	"   .",
+	"  ..",
+	" ..."};
+
+static char * record_xpm[] = {
+	"6 5 4 1",
+	" 	c #AEAAAE",
+	".	c #FA0808",
+	"+	c #FF0000",
+	"@	c #FE0000",
+	" .++@ ",
+	"..@.+@",
+	".@@@.@",
+	".@@@+@",
+	" .@+@ "};
+
+static char * mute_xpm[] = {
+	"10 9 3 1",
+	" 	c #FF0000",
+	".	c #AEAAAE",
+	"+	c #000000",
+	" ........ ",
+	". ....++ .",
+	".. ..+.+..",
+	"..+++. +..",
+	"..+.  .+..",
+	"..+++. +..",
+	".. ..+.+..",
+	". ....++ .",
+	" ........ "};
+
+int run_dockapps(int argc, char **argv);
+WMPixmap *icon_name_to_pixmap(const char *icon_name);
+void create_slider_colors(void);
+void create_dockapps(void);
+void setup_window(Dockapp *dockapp, WMWindow *window);
+void setup_icon_text(void);
+void update_stats_overlay(void *data);
+void poll_signals(void *data);
+void mark_dirty(Dockapp *dockapp, unsigned int dirty);
+void paint_dockapps(void *data);
+void draw_icon(Dockapp *dockapp, PulseDevice *device);
+void draw_muted(Dockapp *dockapp, PulseDevice *device);
+void draw_slider(Dockapp *dockapp, PulseDevice *device);
+void mark_all_dirty(void);
+void mark_slider_dirty(PulseDevice *device);
+void mark_muted_dirty(PulseDevice *device);
+int y_to_bar(int y);
+
+/* looked up by load_dockapp_module() */
+DockappModule dockapp_module = {
+	run_dockapps,
+	mark_all_dirty,
+	mark_slider_dirty,
+	mark_muted_dirty
+};
+
+int run_dockapps(int argc, char **argv)
+{
+	int i;
+	Display *display;
+
+	WMInitializeApplication(PACKAGE_NAME, &argc, argv);
+
+	/* for looking up icons */
+	gtk_init(&argc, &argv);
+
+	if (replay_file)
+		setup_trace_replay(replay_file);
+	else
+		add_servers();
+
+	display = XOpenDisplay("");
+	if (!display) {
+		werror("could not connect to X server");
+		exit(EXIT_FAILURE);
+	}
+
+	screen = WMCreateScreen(display, DefaultScreen(display));
+	create_slider_colors();
+	create_dockapps();
+	if (stats_overlay || monitor)
+		setup_icon_text();
+	for (i = 0; i < HOTKEY_COUNT; i++)
+		if (hotkey_keysyms[i])
+			set_hotkey(i, hotkey_keysyms[i]);
+	if (use_hotkeys && !trace_replaying())
+		setup_hotkeys(display, get_dockapp(0)->selection);
+	setup_pulse();
+	if (monitor && !trace_replaying())
+		setup_monitor();
+	if (use_control && !trace_replaying())
+		setup_control(control_path ? control_path :
+			      get_default_control_path());
+
+	if (trace_replaying()) {
+		start_replay();
+	} else {
+		watch_pulse_mainloop();
+		/* a signal doesn't wake WINGs up, so look for a stats dump
+		   request now and then */
+		WMAddPersistentTimerHandler(100, poll_signals, NULL);
+	}
+	WMScreenMainLoop(screen);
+
+	return 0;
+}
+
+WMPixmap *icon_name_to_pixmap(const char *icon_name) {
+	const char *file;
+	GtkIconTheme *theme;
+	GtkIconInfo *icon_info;
+	WMPixmap *pixmap;
+
+	RColor bg = {40, 40, 40, 255};
+
+	STATS_COUNT(STAT_ICON_LOOKUPS);
+
+	if (!icon_name)
+		goto error;
+
+	theme = gtk_icon_theme_get_default();
+	if (!theme)
+		goto error;
+
+	icon_info = gtk_icon_theme_lookup_icon(
+		theme, icon_name, 22, GTK_ICON_LOOKUP_GENERIC_FALLBACK);
+	if (!icon_info)
+		goto error;
+
+	file = gtk_icon_info_get_filename(icon_info);
+
+	pixmap = WMCreateScaledBlendedPixmapFromFile(screen, file, &bg, 22, 22);
+	STATS_COUNT(STAT_ALLOCATIONS);
+
+	g_object_unref(icon_info);
+
+	return pixmap;
+
+error:
+	werror("unable to get icon");
+	STATS_COUNT(STAT_ALLOCATIONS);
+	return WMCreatePixmap(screen, 22, 22, 0, False);
+}
+
+/* devices with the same icon share one pixmap, whichever dockapp shows
+   them */
+WMPixmap *get_device_icon(PulseDevice *device)
+{
+	const char *key;
+
+	if (device->icon)
+		return device->icon;
+
+	if (!icon_cache)
+		icon_cache = WMCreateHashTable(WMStringHashCallbacks);
+	key = device->icon_name ? device->icon_name : "";
+	device->icon = WMHashGet(icon_cache, key);
+	if (!device->icon) {
+		STATS_BEGIN(STAT_ICON_LOOKUP);
+		device->icon = icon_name_to_pixmap(device->icon_name);
+		STATS_END(STAT_ICON_LOOKUP);
+		WMHashInsert(icon_cache, key, device->icon);
+	}
+
+	return device->icon;
+}
+
+/* one window per --window option, all sharing the same connection and
+   device list */
+void create_dockapps(void)
+{
+	int i;
+	char name[32];
+	const char *filter;
+	Dockapp *dockapp;
+
+	if (WMGetArrayItemCount(window_filters) == 0)
+		WMAddToArray(window_filters, "all");
+
+	dockapps = WMCreateArray(WMGetArrayItemCount(window_filters));
+	for (i = 0; i < WMGetArrayItemCount(window_filters); i++) {
+		filter = WMGetFromArray(window_filters, i);
+		dockapp = wmalloc(sizeof(Dockapp));
+		dockapp->number = i;
+		dockapp->selection = create_selection(filter);
+		if (!dockapp->selection) {
+			werror("unknown window filter '%s'", filter);
+			exit(EXIT_FAILURE);
+		}
+
+		/* distinct instance names, so the dock can tell the windows
+		   apart */
+		if (i == 0)
+			snprintf(name, sizeof(name), "%s", PACKAGE_NAME);
+		else
+			snprintf(name, sizeof(name), "%s%d", PACKAGE_NAME,
+				 i + 1);
+		setup_window(dockapp, WMCreateWindow(screen, name));
+		WMAddToArray(dockapps, dockapp);
+	}
+}
+
+Dockapp *get_dockapp(int n)
+{
+	if (n < 0 || n >= WMGetArrayItemCount(dockapps))
+		return NULL;
+
+	return WMGetFromArray(dockapps, n);
+}
+
+PulseSelection *get_dockapp_selection(int n)
+{
+	Dockapp *dockapp;
+
+	dockapp = get_dockapp(n);
+	return dockapp ? dockapp->selection : NULL;
+}
+
+void setup_window(Dockapp *dockapp, WMWindow *window) {
+	Display *display;
+	Window xid;
+	XRectangle rect[3];
+	XWMHints *hints;
+	WMColor *bg;
+	WMFrame *icon_frame, *slider_frame;
+	WMButton *left_button, *right_button, *record_button;
+	WMPixmap *left_pix, *right_pix, *record_pix, *mute_pix;
+	WMLabel *icon_label, *slider_label;
+	WMButton *mute_button;
+
+	WMRealizeWidget(window);
+	WMResizeWidget(window, DOCKAPP_MEASURE, DOCKAPP_MEASURE);
+
+	xid = WMWidgetXID(window);
+	screen = WMWidgetScreen(window);
+	display = WMScreenDisplay(screen);
+
+	hints = XGetWMHints(display, xid);
+	hints->flags |= WindowGroupHint;
+	hints->window_group = xid;
+
+	/* TODO - allow windowed mode */
+	hints->flags |= IconWindowHint | StateHint;
+	hints->icon_window = xid;
+	hints->initial_state = WithdrawnState;
+
+	XSetWMHints(display, xid, hints);
+	XFree(hints);
+
+	/* icons */
+	rect[0].x = MARGIN;
+	rect[0].y = MARGIN;
+	rect[0].width = 2 * BUTTON_MEASURE;
+	rect[0].height = ICON_MEASURE + 2;
+
+	/* buttons */
+	rect[1].x = MARGIN;
+	rect[1].y = BUTTON_Y;
+	rect[1].width = 2 * BUTTON_MEASURE;
+	rect[1].height = 2 * BUTTON_MEASURE;
+
+	/* volume slider */
+	rect[2].x = SLIDER_X;
+	rect[2].y = MARGIN;
+	rect[2].width = SLIDER_WIDTH;
+	rect[2].height = SLIDER_HEIGHT;
+
+	XShapeCombineRectangles(display, xid, ShapeBounding, 0, 0, rect, 3,
+				ShapeSet, Unsorted);
+
+	bg = WMCreateRGBColor(screen, 0x2800, 0x2800, 0x2800, False);
+
+	icon_frame = WMCreateFrame(window);
+	WMSetFrameRelief(icon_frame, WRPushed);
+	WMResizeWidget(icon_frame, 2 * BUTTON_MEASURE, ICON_MEASURE + 2);
+	WMMoveWidget(icon_frame, MARGIN, MARGIN);
+	WMRealizeWidget(icon_frame);
+
+	icon_label = WMCreateLabel(icon_frame);
+	WMResizeWidget(icon_label, ICON_MEASURE + 2, ICON_MEASURE);
+	WMMoveWidget(icon_label, 1, 1);
+	WMSetWidgetBackgroundColor(icon_label, bg);
+	WMSetLabelImagePosition(icon_label, WIPImageOnly);
+	WMRealizeWidget(icon_label);
+
+	slider_frame = WMCreateFrame(window);
+	WMSetFrameRelief(slider_frame, WRPushed);
+	WMResizeWidget(slider_frame, SLIDER_WIDTH, SLIDER_HEIGHT);
+	WMMoveWidget(slider_frame, SLIDER_X, MARGIN);
+	WMSetWidgetBackgroundColor(slider_frame, bg);
+	WMRealizeWidget(slider_frame);
+
+	slider_label = WMCreateLabel(slider_frame);
+	WMResizeWidget(slider_label, SLIDER_WIDTH - 2, SLIDER_HEIGHT - 2);
+	WMMoveWidget(slider_label, 1, 1);
+	WMSetWidgetBackgroundColor(slider_label, bg);
+	WMSetLabelImagePosition(slider_label, WIPImageOnly);
+	WMCreateEventHandler(
+		WMWidgetView(slider_label),
+		ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
+		slider_event, dockapp);
+	WMRealizeWidget(slider_label);
+
+	left_button = WMCreateButton(window, WBTMomentaryPush);
+	WMResizeWidget(left_button, BUTTON_MEASURE, BUTTON_MEASURE);
+	WMMoveWidget(left_button, MARGIN, BUTTON_Y);
+	left_pix = WMCreatePixmapFromXPMData(screen, left_xpm);
+	WMSetButtonImage(left_button, left_pix);
+	WMSetButtonImagePosition(left_button, WIPImageOnly);
+	WMSetButtonAction(left_button, previous_device_action, dockapp);
+	WMRealizeWidget(left_button);
+
+	right_button = WMCreateButton(window, WBTMomentaryPush);
+	WMResizeWidget(right_button, BUTTON_MEASURE, BUTTON_MEASURE);
+	WMMoveWidget(right_button, MARGIN + BUTTON_MEASURE, BUTTON_Y);
+	right_pix = WMCreatePixmapFromXPMData(screen, right_xpm);
+	WMSetButtonImage(right_button, right_pix);
+	WMSetButtonImagePosition(right_button, WIPImageOnly);
+	WMSetButtonAction(right_button, next_device_action, dockapp);
+	WMRealizeWidget(right_button);
+
+	record_button = WMCreateButton(window, WBTToggle);
+	WMResizeWidget(record_button, BUTTON_MEASURE, BUTTON_MEASURE);
+	WMMoveWidget(record_button, MARGIN, BUTTON_Y + BUTTON_MEASURE);
+	record_pix = WMCreatePixmapFromXPMData(screen, record_xpm);
+	WMSetButtonImage(record_button, record_pix);
+	WMSetButtonImagePosition(record_button, WIPImageOnly);
+	/* TODO - implement recording */
+	WMSetButtonEnabled(record_button, False);
+	WMRealizeWidget(record_button);
+
+	mute_button = WMCreateButton(window, WBTToggle);
+	WMResizeWidget(mute_button, BUTTON_MEASURE, BUTTON_MEASURE);
+	WMMoveWidget(mute_button, MARGIN + BUTTON_MEASURE,
+		     BUTTON_Y + BUTTON_MEASURE);
+	mute_pix = WMCreatePixmapFromXPMData(screen, mute_xpm);
+	WMSetButtonImage(mute_button, mute_pix);
+	WMSetButtonImagePosition(mute_button, WIPImageOnly);
+	WMSetButtonAction(mute_button, mute_action, dockapp);
+	WMRealizeWidget(mute_button);
+
+	WMMapWidget(window);
+	WMMapSubwidgets(window);
+	WMMapWidget(icon_label);
+	WMMapWidget(slider_label);
+
+	dockapp->icon_label = icon_label;
+	dockapp->slider_label = slider_label;
+	dockapp->mute_button = mute_button;
+}
+
+WMScreen *get_screen(void) {
+	return screen;
+}
+
+/* for the stats overlay and the latency monitor's flags */
+void setup_icon_text(void)
+{
+	int i;
+	WMFont *font;
+	Dockapp *dockapp;
+
+	font = WMSystemFontOfSize(screen, 8);
+	text_color = WMWhiteColor(screen);
+	flag_color = WMCreateNamedColor(screen, "red", True);
+	for (i = 0; i < WMGetArrayItemCount(dockapps); i++) {
+		dockapp = WMGetFromArray(dockapps, i);
+		WMSetLabelImagePosition(dockapp->icon_label, WIPOverlaps);
+		WMSetLabelFont(dockapp->icon_label, font);
+	}
+	WMReleaseFont(font);
+
+	if (stats_overlay)
+		WMAddPersistentTimerHandler(1000, update_stats_overlay,
+					    NULL);
+}
+
+void update_stats_overlay(void *data)
+{
+	int i;
+
+	(void)data;
+
+	format_stats_overlay(stats_text, sizeof(stats_text));
+	for (i = 0; i < WMGetArrayItemCount(dockapps); i++)
+		mark_dirty(WMGetFromArray(dockapps, i), DIRTY_ICON);
+}
+
+void poll_signals(void *data)
+{
+	(void)data;
+
+	poll_stats();
+	poll_trace();
+}
+
+void create_slider_colors(void)
+{
+	int i;
+
+	/* based on XHandler::mixColor() from wmmixer */
+	for (i = 0; i < 25; i++) {
+		slider_color[i].red = 255 * i / (50 - i);
+		slider_color[i].green = 255 * (50 - 2 * i) / (50 - i);
+		slider_color[i].blue = 0;
+		slider_color[i].alpha = 255;
+	}
+}
+
+void mark_all_dirty(void)
+{
+	int i;
+
+	for (i = 0; i < WMGetArrayItemCount(dockapps); i++)
+		mark_dirty(WMGetFromArray(dockapps, i), DIRTY_ALL);
+}
+
+/* Model changes only mark what is out of date.  The dockapps are painted
+ * once idle, so a burst of replies handled together costs one paint, and
+ * no more than max_fps times a second, so a longer storm is spread over
+ * frames instead of painting every change. */
+void mark_dirty(Dockapp *dockapp, unsigned int dirty)
+{
+	uint64_t interval, elapsed;
+
+	STATS_COUNT(STAT_PAINT_REQUESTS);
+	dockapp->dirty |= dirty;
+	if (paint_handler)
+		return;
+
+	interval = max_fps > 0 ? 1000000 / max_fps : 0;
+	elapsed = monotonic_usec() - last_paint;
+	paint_when_idle = elapsed >= interval;
+	if (paint_when_idle)
+		paint_handler = WMAddIdleHandler(paint_dockapps, NULL);
+	else
+		paint_handler = WMAddTimerHandler(
+			(interval - elapsed + 999) / 1000, paint_dockapps,
+			NULL);
+}
+
+void paint_dockapps(void *data)
+{
+	int i;
+	Dockapp *dockapp;
+	PulseDevice *device;
+
+	(void)data;
+
+	paint_handler = NULL;
+	last_paint = monotonic_usec();
+
+	for (i = 0; i < WMGetArrayItemCount(dockapps); i++) {
+		dockapp = WMGetFromArray(dockapps, i);
+		if (!dockapp->dirty)
+			continue;
+
+		STATS_COUNT(STAT_PAINTS);
+		device = get_selected_device(dockapp->selection);
+		if (dockapp->dirty & DIRTY_ICON)
+			draw_icon(dockapp, device);
+		if (dockapp->dirty & DIRTY_MUTED)
+			draw_muted(dockapp, device);
+		if (dockapp->dirty & DIRTY_SLIDER)
+			draw_slider(dockapp, device);
+		dockapp->dirty = 0;
+	}
+}
+
+/* paint now rather than at the next frame */
+void flush_paints(void)
+{
+	if (!paint_handler)
+		return;
+
+	if (paint_when_idle)
+		WMDeleteIdleHandler(paint_handler);
+	else
+		WMDeleteTimerHandler(paint_handler);
+	paint_dockapps(NULL);
+}
+
+void draw_icon(Dockapp *dockapp, PulseDevice *device)
+{
+	char *balloon;
+	char flag[16];
+
+	STATS_BEGIN(STAT_DEVICE_REDRAW);
+
+	if (device && device->server->address) {
+		balloon = wstrconcat(device->description, " on ");
+		balloon = wstrappend(balloon, device->server->address);
+	} else {
+		balloon = device ? wstrdup(device->description) : NULL;
+	}
+	if (balloon)
+		STATS_COUNT(STAT_ALLOCATIONS);
+	WMSetBalloonTextForView(balloon, WMWidgetView(dockapp->icon_label));
+	if (balloon)
+		wfree(balloon);
+	WMSetLabelImage(dockapp->icon_label,
+			device ? get_device_icon(device) : NULL);
+
+	/* a flagged device's figures take the place of the overlay */
+	if (device && format_monitor_flag(device, flag, sizeof(flag))) {
+		WMSetLabelTextColor(dockapp->icon_label, flag_color);
+		WMSetLabelText(dockapp->icon_label, flag);
+	} else if (stats_overlay) {
+		WMSetLabelTextColor(dockapp->icon_label, text_color);
+		WMSetLabelText(dockapp->icon_label, stats_text);
+	} else {
+		WMSetLabelText(dockapp->icon_label, NULL);
+	}
+	WMRedisplayWidget(dockapp->icon_label);
+
+	STATS_END(STAT_DEVICE_REDRAW);
+}
+
+/* repaint the mute button of every dockapp showing the device */
+void mark_muted_dirty(PulseDevice *device)
+{
+	int i;
+	Dockapp *dockapp;
+
+	for (i = 0; i < WMGetArrayItemCount(dockapps); i++) {
+		dockapp = WMGetFromArray(dockapps, i);
+		if (get_selected_device(dockapp->selection) == device)
+			mark_dirty(dockapp, DIRTY_MUTED);
+	}
+}
+
+/* repaint the slider of every dockapp showing the device */
+void mark_slider_dirty(PulseDevice *device)
+{
+	int i;
+	Dockapp *dockapp;
+
+	for (i = 0; i < WMGetArrayItemCount(dockapps); i++) {
+		dockapp = WMGetFromArray(dockapps, i);
+		if (get_selected_device(dockapp->selection) == device)
+			mark_dirty(dockapp, DIRTY_SLIDER);
+	}
+}
+
+void draw_muted(Dockapp *dockapp, PulseDevice *device)
+{
+	WMSetButtonSelected(dockapp->mute_button, device && device->muted);
+	WMRedisplayWidget(dockapp->mute_button);
+}
+
+void draw_slider(Dockapp *dockapp, PulseDevice *device)
+{
+	int i, n;
+	RImage *image;
+	WMPixmap *slider_pix;
+
+	RColor bg = {40, 40, 40, 255};
+
+	STATS_BEGIN(STAT_SLIDER_REDRAW);
+
+	image = RCreateImage(SLIDER_WIDTH - 2, SLIDER_HEIGHT - 2, False);
+	STATS_COUNT(STAT_ALLOCATIONS);
+	RFillImage(image, &bg);
+
+	n = device ? volume_to_int(device->volume) : 0;
+	for (i = 0; i < n; i++)
+		RDrawLine(image, 1, SLIDER_HEIGHT - 5 - 2 * i,
+			  SLIDER_WIDTH - 5, SLIDER_HEIGHT - 5 - 2 * i,
+			  &slider_color[i]);
+
+	slider_pix = WMCreatePixmapFromRImage(screen, image, 127);
+	STATS_COUNT(STAT_ALLOCATIONS);
+	WMSetLabelImage(dockapp->slider_label, slider_pix);
+	WMReleasePixmap(slider_pix);
+	WMRedisplayWidget(dockapp->slider_label);
+
+	RReleaseImage(image);
+
+	STATS_END(STAT_SLIDER_REDRAW);
+}
+
+void next_device_action(WMWidget *widget, void *data)
+{
+	Dockapp *dockapp = data;
+
+	(void)widget;
+
+	trace_action(dockapp->number, TRACE_NEXT_DEVICE);
+	select_next_device(dockapp->selection);
+	mark_dirty(dockapp, DIRTY_ALL);
+}
+
+void previous_device_action(WMWidget *widget, void *data)
+{
+	Dockapp *dockapp = data;
+
+	(void)widget;
+
+	trace_action(dockapp->number, TRACE_PREVIOUS_DEVICE);
+	select_previous_device(dockapp->selection);
+	mark_dirty(dockapp, DIRTY_ALL);
+}
+
+void mute_action(WMWidget *widget, void *data)
+{
+	Dockapp *dockapp = data;
+	PulseDevice *device;
+
+	(void)widget;
+
+	trace_action(dockapp->number, TRACE_TOGGLE_MUTED);
+	device = get_selected_device(dockapp->selection);
+	if (device)
+		toggle_device_muted(device);
+	else
+		/* nothing to mute, so undo the button's own toggle */
+		mark_dirty(dockapp, DIRTY_MUTED);
+}
+
+void slider_event(XEvent *event, void *data)
+{
+	Dockapp *dockapp = data;
+	PulseDevice *device;
+
+	trace_x_event(dockapp->number, event);
+
+	device = get_selected_device(dockapp->selection);
+	if (!device)
+		return;
+
+	if (((event->type == ButtonPress || event->type == ButtonRelease)
+	     && event->xbutton.button == Button1) ||
+	    (event->type == MotionNotify && event->xmotion.state & Button1Mask))
+		set_device_volume(device, y_to_bar(event->xbutton.y));
+	else if (event->type != ButtonPress)
+		return;
+	else if (event->xbutton.button == Button2)
+		solo_device(device);
+	else if (event->xbutton.button == Button3)
+		toggle_group_muted(PULSE_GROUP(device->type));
+	else if (event->xbutton.button == Button4 &&
+		 event->xbutton.state & ShiftMask)
+		change_group_volume_by(PULSE_GROUP(device->type), 1);
+	else if (event->xbutton.button == Button5 &&
+		 event->xbutton.state & ShiftMask)
+		change_group_volume_by(PULSE_GROUP(device->type), -1);
+	else if (event->xbutton.button == Button4)
+		change_device_volume_by(device, 1);
+	else if (event->xbutton.button == Button5)
+		change_device_volume_by(device, -1);
+}
+
+int y_to_bar(int y)
+{
+	int result;
+
+	result = (SLIDER_HEIGHT - 2 - y) / 2;
+	if (result < 0)
+		return 0;
+	else if (result > 25)
+		return 25;
+	else
+		return result;
+}
@@ -0,0 +1,41 @@
+/* wmpmixer - PulseAudio mixer as a Window Maker dockapp
+ * Copyright (C) 2021 Doug Torrance <dtorrance@piedmont.edu>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef DOCKAPP_H
+#define DOCKAPP_H
+
+#include <WINGs/WINGs.h>
+
+#include <X11/Xlib.h>
+
+#include "pulse.h"
+
+typedef struct Dockapp Dockapp;
+
+WMScreen *get_screen(void);
+Dockapp *get_dockapp(int n);
+PulseSelection *get_dockapp_selection(int n);
+void flush_paints(void);
+WMPixmap *get_device_icon(PulseDevice *device);
+void slider_event(XEvent *event, void *data);
+void next_device_action(WMWidget *widget, void *data);
+void previous_device_action(WMWidget *widget, void *data);
+void mute_action(WMWidget *widget, void *data);
+
+#endif
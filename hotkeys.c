@@ -0,0 +1,227 @@
+/* wmpmixer - PulseAudio mixer as a Window Maker dockapp
+ * Copyright (C) 2021 Doug Torrance <dtorrance@piedmont.edu>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include "hotkeys.h"
+#include "pulse.h"
+#include "trace.h"
+
+#include <WINGs/WINGs.h>
+#include <WINGs/WUtil.h>
+#include <X11/X.h>
+#include <X11/XKBlib.h>
+#include <X11/Xlib.h>
+#include <X11/Xproto.h>
+
+/* every auto-repeat after this many adds another step */
+#define REPEATS_PER_STEP 4
+#define MAX_STEP 3
+
+const char *hotkey_names[HOTKEY_COUNT] = {
+	"XF86AudioRaiseVolume",
+	"XF86AudioLowerVolume",
+	"XF86AudioMute"
+};
+
+KeyCode hotkey_codes[HOTKEY_COUNT];
+WMEventHook *next_event_hook;
+Bool detectable_repeat;
+KeyCode held_key = 0;
+int held_repeats;
+PulseSelection *hotkey_selection;
+Bool grab_failed;
+
+int grab_error(Display *display, XErrorEvent *error);
+Bool grab_hotkey(Display *display, Window root, KeyCode code);
+void hotkey_event(XEvent *event);
+
+void set_hotkey(hotkey key, const char *keysym_name)
+{
+	hotkey_names[key] = keysym_name;
+}
+
+/* another client holding the key answers a grab with BadAccess, which
+   would otherwise take the default handler's exit() with it */
+int grab_error(Display *display, XErrorEvent *error)
+{
+	(void)display;
+
+	if (error->request_code == X_GrabKey)
+		grab_failed = True;
+	return 0;
+}
+
+/* grab with and without shift, whatever the state of caps and num lock */
+Bool grab_hotkey(Display *display, Window root, KeyCode code)
+{
+	int i, j;
+	unsigned int modifiers[] = {0, ShiftMask};
+	unsigned int locks[] = {0, LockMask, Mod2Mask, LockMask | Mod2Mask};
+
+	grab_failed = False;
+	for (i = 0; i < 2; i++)
+		for (j = 0; j < 4; j++)
+			XGrabKey(display, code, modifiers[i] | locks[j], root,
+				 True, GrabModeAsync, GrabModeAsync);
+	XSync(display, False);
+
+	/* half a key is worse than none */
+	if (grab_failed) {
+		XUngrabKey(display, code, AnyModifier, root);
+		XSync(display, False);
+	}
+
+	return !grab_failed;
+}
+
+void setup_hotkeys(Display *display, PulseSelection *selection)
+{
+	int i;
+	Bool supported;
+	KeySym keysym;
+	Window root;
+	XErrorHandler previous_handler;
+
+	hotkey_selection = selection;
+	root = DefaultRootWindow(display);
+	previous_handler = XSetErrorHandler(grab_error);
+	for (i = 0; i < HOTKEY_COUNT; i++) {
+		keysym = XStringToKeysym(hotkey_names[i]);
+		if (keysym == NoSymbol) {
+			wwarning("unknown key '%s'", hotkey_names[i]);
+			continue;
+		}
+
+		hotkey_codes[i] = XKeysymToKeycode(display, keysym);
+		if (!hotkey_codes[i]) {
+			wwarning("no key is mapped to %s", hotkey_names[i]);
+			continue;
+		}
+
+		if (!grab_hotkey(display, root, hotkey_codes[i])) {
+			wwarning("unable to grab %s, another client has it",
+				 hotkey_names[i]);
+			hotkey_codes[i] = 0;
+		}
+	}
+	XSetErrorHandler(previous_handler);
+
+	/* report a held key as repeated presses with no releases in
+	   between, so a repeat can be told from a new press */
+	detectable_repeat = XkbSetDetectableAutoRepeat(display, True,
+						       &supported) &&
+		supported;
+
+	/* root window events have no WINGs view, so they only reach us
+	   through the hook */
+	next_event_hook = WMHookEventHandler(hotkey_event);
+}
+
+void hotkey_event(XEvent *event)
+{
+	int i;
+	Bool shifted;
+	XEvent next;
+
+	if (event->type == KeyRelease && event->xkey.keycode == held_key) {
+		/* without detectable auto-repeat, a repeat shows up as a
+		   release immediately followed by a press */
+		if (!detectable_repeat &&
+		    XEventsQueued(event->xkey.display, QueuedAfterReading)) {
+			XPeekEvent(event->xkey.display, &next);
+			if (next.type == KeyPress &&
+			    next.xkey.keycode == event->xkey.keycode &&
+			    next.xkey.time == event->xkey.time)
+				return;
+		}
+
+		held_key = 0;
+		return;
+	}
+
+	if (event->type == KeyPress) {
+		for (i = 0; i < HOTKEY_COUNT; i++) {
+			if (!hotkey_codes[i] ||
+			    event->xkey.keycode != hotkey_codes[i])
+				continue;
+
+			if (held_key == event->xkey.keycode) {
+				held_repeats++;
+			} else {
+				held_key = event->xkey.keycode;
+				held_repeats = 0;
+			}
+
+			shifted = (event->xkey.state & ShiftMask) != 0;
+			trace_hotkey(i, shifted, held_repeats);
+			hotkey_pressed(hotkey_selection, i, shifted,
+				       held_repeats);
+			return;
+		}
+	}
+
+	if (next_event_hook)
+		next_event_hook(event);
+}
+
+void hotkey_pressed(PulseSelection *selection, hotkey key, Bool shifted,
+		    int repeats)
+{
+	int step;
+	PulseDevice *device;
+
+	device = get_selected_device(selection);
+	if (!device)
+		return;
+
+	step = 1 + repeats / REPEATS_PER_STEP;
+	if (step > MAX_STEP)
+		step = MAX_STEP;
+
+	switch (key) {
+	case HOTKEY_RAISE:
+		if (shifted)
+			change_group_volume_by(PULSE_GROUP(device->type),
+					       step);
+		else
+			change_device_volume_by(device, step);
+		break;
+
+	case HOTKEY_LOWER:
+		if (shifted)
+			change_group_volume_by(PULSE_GROUP(device->type),
+					       -step);
+		else
+			change_device_volume_by(device, -step);
+		break;
+
+	case HOTKEY_MUTE:
+		/* holding mute shouldn't make it flicker */
+		if (repeats > 0)
+			break;
+
+		if (shifted)
+			toggle_group_muted(PULSE_GROUP(device->type));
+		else
+			toggle_device_muted(device);
+		break;
+
+	default:
+		break;
+	}
+}
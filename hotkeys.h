@@ -0,0 +1,39 @@
+/* wmpmixer - PulseAudio mixer as a Window Maker dockapp
+ * Copyright (C) 2021 Doug Torrance <dtorrance@piedmont.edu>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef HOTKEYS_H
+#define HOTKEYS_H
+
+#include <X11/Xlib.h>
+
+#include "pulse.h"
+
+typedef enum {
+	HOTKEY_RAISE,
+	HOTKEY_LOWER,
+	HOTKEY_MUTE,
+	HOTKEY_COUNT
+} hotkey;
+
+void set_hotkey(hotkey key, const char *keysym_name);
+void setup_hotkeys(Display *display, PulseSelection *selection);
+void hotkey_pressed(PulseSelection *selection, hotkey key, Bool shifted,
+		    int repeats);
+
+#endif
@@ -0,0 +1,681 @@
+/* wmpmixer - PulseAudio mixer as a Window Maker dockapp
+ * Copyright (C) 2021 Doug Torrance <dtorrance@piedmont.edu>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include "monitor.h"
+#include "pulse.h"
+#include "stats.h"
+#include "wmpmixer.h"
+
+#include <pulse/context.h>
+#include <pulse/def.h>
+#include <pulse/introspect.h>
+#include <pulse/mainloop-api.h>
+#include <pulse/operation.h>
+#include <pulse/timeval.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <WINGs/WUtil.h>
+
+/* Devices are sampled by introspection, each at its own interval: faster
+ * while its latency is moving, slower while it is steady.  A sink or
+ * source that isn't running, or a corked stream, is parked and costs
+ * nothing until the server reports a change to it.  PulseAudio only
+ * reports underflows to the stream's own client, and a playing stream
+ * is often caught with an empty buffer between two writes, so a single
+ * empty buffer is never taken for an underrun; only a stream that is
+ * found empty in most of its recent samples counts against it. */
+
+/* samples kept per device, so memory doesn't grow with uptime */
+#define MONITOR_HISTORY 32
+/* milliseconds */
+#define MONITOR_MIN_INTERVAL 250
+#define MONITOR_START_INTERVAL 1000
+#define MONITOR_MAX_INTERVAL 8000
+/* devices due this soon after a wakeup are sampled with it */
+#define MONITOR_SLACK 50
+/* how many of the worst devices are flagged on the dockapps */
+#define MONITOR_WORST 3
+/* samples needed before a stream is held to its own lowest latency */
+#define MONITOR_BASELINE 8
+
+typedef struct {
+	/* milliseconds since monitoring started */
+	uint32_t time;
+	pa_usec_t latency;
+	Bool empty_buffer;
+} MonitorSample;
+
+struct MonitorHistory {
+	MonitorSample samples[MONITOR_HISTORY];
+	int head;
+	int count;
+	uint64_t empty_buffers;
+	pa_usec_t configured_latency;
+	int interval;
+	uint64_t due;
+	/* idle, and waiting for the server to report a change */
+	Bool parked;
+	Bool in_flight;
+	Bool flagged;
+};
+
+/* which device a sample was asked for, as it may be gone by the time
+   the answer comes */
+typedef struct {
+	PulseServer *server;
+	pulse_type type;
+	uint32_t index;
+} MonitorQuery;
+
+Bool monitoring = False;
+uint64_t monitor_started;
+/* disabled while no device is due */
+pa_time_event *monitor_event;
+
+const char *monitor_type_names[] = {
+	"sink",
+	"source",
+	"sink-input",
+	"source-output"
+};
+
+void schedule_monitor(void);
+Bool can_sample(PulseDevice *device);
+void monitor_tick(pa_mainloop_api *api, pa_time_event *event,
+		  const struct timeval *tv, void *userdata);
+MonitorHistory *get_history(PulseDevice *device);
+void send_sample(PulseDevice *device);
+void sink_sample_cb(pa_context *ctx, const pa_sink_info *info, int eol,
+		    void *userdata);
+void source_sample_cb(pa_context *ctx, const pa_source_info *info, int eol,
+		      void *userdata);
+void sink_input_sample_cb(pa_context *ctx, const pa_sink_input_info *info,
+			  int eol, void *userdata);
+void source_output_sample_cb(pa_context *ctx,
+			     const pa_source_output_info *info, int eol,
+			     void *userdata);
+PulseDevice *get_query_device(MonitorQuery *query);
+void sample_done(MonitorQuery *query, int eol);
+void record_sample(PulseDevice *device, pa_usec_t latency,
+		   pa_usec_t configured_latency, Bool empty_buffer, Bool idle);
+pa_usec_t parent_latency(PulseDevice *stream, pulse_type type,
+			 uint32_t index);
+pa_usec_t mean_latency(MonitorHistory *history);
+pa_usec_t reference_latency(MonitorHistory *history);
+Bool latency_too_high(MonitorHistory *history);
+int empty_percent(MonitorHistory *history);
+uint64_t get_score(MonitorHistory *history);
+void update_flags(void);
+void write_json_string(FILE *fp, const char *str);
+
+/* runs on the PulseAudio main loop, so it works headless too */
+void setup_monitor(void)
+{
+	pa_mainloop_api *api;
+
+	monitoring = True;
+	monitor_started = monotonic_usec() / 1000;
+
+	api = get_pulse_mainloop_api();
+	monitor_event = api->time_new(api, NULL, monitor_tick, NULL);
+}
+
+/* called once the server's devices are known */
+void start_monitor(PulseServer *server)
+{
+	if (!monitoring || !server->ctx ||
+	    pa_context_get_state(server->ctx) != PA_CONTEXT_READY)
+		return;
+
+	schedule_monitor();
+}
+
+/* wake up when the next device is due; with every device parked or
+   waiting for a reply, sleep until one of them changes */
+void schedule_monitor(void)
+{
+	int i;
+	uint64_t now, due;
+	Bool any;
+	struct timeval tv;
+	WMArray *devices;
+	PulseDevice *device;
+	pa_mainloop_api *api;
+
+	if (!monitoring)
+		return;
+
+	any = False;
+	due = 0;
+	devices = get_devices();
+	for (i = 0; i < WMGetArrayItemCount(devices); i++) {
+		device = WMGetFromArray(devices, i);
+		if (!can_sample(device))
+			continue;
+
+		if (!any || device->history->due < due)
+			due = device->history->due;
+		any = True;
+	}
+
+	api = get_pulse_mainloop_api();
+	if (!any) {
+		api->time_restart(monitor_event, NULL);
+		return;
+	}
+
+	now = monotonic_usec() / 1000;
+	pa_gettimeofday(&tv);
+	if (due > now)
+		pa_timeval_add(&tv, (due - now) * PA_USEC_PER_MSEC);
+	api->time_restart(monitor_event, &tv);
+}
+
+Bool can_sample(PulseDevice *device)
+{
+	MonitorHistory *history;
+
+	if (!device->server->loaded || !device->server->ctx ||
+	    pa_context_get_state(device->server->ctx) != PA_CONTEXT_READY)
+		return False;
+
+	history = get_history(device);
+	return !history->parked && !history->in_flight;
+}
+
+void monitor_tick(pa_mainloop_api *api, pa_time_event *event,
+		  const struct timeval *tv, void *userdata)
+{
+	int i;
+	uint64_t now;
+	WMArray *devices;
+	PulseDevice *device;
+
+	(void)api;
+	(void)event;
+	(void)tv;
+	(void)userdata;
+
+	now = monotonic_usec() / 1000;
+	devices = get_devices();
+	for (i = 0; i < WMGetArrayItemCount(devices); i++) {
+		device = WMGetFromArray(devices, i);
+		if (can_sample(device) &&
+		    now + MONITOR_SLACK >= device->history->due)
+			send_sample(device);
+	}
+
+	schedule_monitor();
+}
+
+MonitorHistory *get_history(PulseDevice *device)
+{
+	MonitorHistory *history;
+
+	if (device->history)
+		return device->history;
+
+	history = wmalloc(sizeof(MonitorHistory));
+	STATS_COUNT(STAT_ALLOCATIONS);
+	history->head = 0;
+	history->count = 0;
+	history->empty_buffers = 0;
+	history->configured_latency = 0;
+	history->interval = MONITOR_START_INTERVAL;
+	history->due = 0;
+	history->parked = False;
+	history->in_flight = False;
+	history->flagged = False;
+	device->history = history;
+
+	return history;
+}
+
+void send_sample(PulseDevice *device)
+{
+	pa_context *ctx = device->server->ctx;
+	pa_operation *op;
+	MonitorQuery *query;
+
+	query = wmalloc(sizeof(MonitorQuery));
+	STATS_COUNT(STAT_ALLOCATIONS);
+	query->server = device->server;
+	query->type = device->type;
+	query->index = device->index;
+
+	switch (device->type) {
+	case PULSE_SINK:
+		op = pa_context_get_sink_info_by_index(
+			ctx, device->index, sink_sample_cb, query);
+		break;
+
+	case PULSE_SOURCE:
+		op = pa_context_get_source_info_by_index(
+			ctx, device->index, source_sample_cb, query);
+		break;
+
+	case PULSE_SINK_INPUT:
+		op = pa_context_get_sink_input_info(
+			ctx, device->index, sink_input_sample_cb, query);
+		break;
+
+	case PULSE_SOURCE_OUTPUT:
+		op = pa_context_get_source_output_info(
+			ctx, device->index, source_output_sample_cb, query);
+		break;
+
+	default:
+		op = NULL;
+		break;
+	}
+
+	if (op) {
+		device->history->in_flight = True;
+		pa_operation_unref(op);
+	} else {
+		wfree(query);
+		/* try again later rather than at once */
+		device->history->due = monotonic_usec() / 1000 +
+			device->history->interval;
+	}
+}
+
+void sink_sample_cb(pa_context *ctx, const pa_sink_info *info, int eol,
+		    void *userdata)
+{
+	PulseDevice *device;
+
+	(void)ctx;
+
+	device = get_query_device(userdata);
+	if (eol)
+		sample_done(userdata, eol);
+	else if (device)
+		record_sample(device, info->latency,
+			      info->configured_latency, False,
+			      info->state != PA_SINK_RUNNING);
+}
+
+void source_sample_cb(pa_context *ctx, const pa_source_info *info, int eol,
+		      void *userdata)
+{
+	PulseDevice *device;
+
+	(void)ctx;
+
+	device = get_query_device(userdata);
+	if (eol)
+		sample_done(userdata, eol);
+	else if (device)
+		record_sample(device, info->latency,
+			      info->configured_latency, False,
+			      info->state != PA_SOURCE_RUNNING);
+}
+
+void sink_input_sample_cb(pa_context *ctx, const pa_sink_input_info *info,
+			  int eol, void *userdata)
+{
+	PulseDevice *device;
+
+	(void)ctx;
+
+	device = get_query_device(userdata);
+	if (eol)
+		sample_done(userdata, eol);
+	else if (device)
+		record_sample(device, info->buffer_usec + info->sink_usec,
+			      parent_latency(device, PULSE_SINK, info->sink),
+			      !info->corked && info->buffer_usec == 0,
+			      info->corked);
+}
+
+void source_output_sample_cb(pa_context *ctx,
+			     const pa_source_output_info *info, int eol,
+			     void *userdata)
+{
+	PulseDevice *device;
+
+	(void)ctx;
+
+	device = get_query_device(userdata);
+	if (eol)
+		sample_done(userdata, eol);
+	else if (device)
+		record_sample(device,
+			      info->buffer_usec + info->source_usec,
+			      parent_latency(device, PULSE_SOURCE,
+					     info->source),
+			      False, info->corked);
+}
+
+/* a stream asks for no latency of its own, so it is held to what its
+   sink or source asked for, once that has been sampled */
+pa_usec_t parent_latency(PulseDevice *stream, pulse_type type,
+			 uint32_t index)
+{
+	PulseDevice *device;
+
+	device = find_device(stream->server, type, index);
+	if (!device || !device->history)
+		return 0;
+
+	return device->history->configured_latency;
+}
+
+PulseDevice *get_query_device(MonitorQuery *query)
+{
+	return find_device(query->server, query->type, query->index);
+}
+
+/* a device that has gone away stays parked */
+void sample_done(MonitorQuery *query, int eol)
+{
+	PulseDevice *device;
+
+	device = get_query_device(query);
+	wfree(query);
+	if (!device)
+		return;
+
+	device->history->in_flight = False;
+	if (eol < 0)
+		device->history->parked = True;
+	schedule_monitor();
+}
+
+void record_sample(PulseDevice *device, pa_usec_t latency,
+		   pa_usec_t configured_latency, Bool empty_buffer, Bool idle)
+{
+	int n;
+	pa_usec_t previous;
+	MonitorHistory *history;
+	MonitorSample *sample;
+
+	history = device->history;
+	if (idle) {
+		history->parked = True;
+		return;
+	}
+
+	previous = 0;
+	if (history->count > 0) {
+		n = (history->head + MONITOR_HISTORY - 1) % MONITOR_HISTORY;
+		previous = history->samples[n].latency;
+	}
+
+	sample = &history->samples[history->head];
+	sample->time = monotonic_usec() / 1000 - monitor_started;
+	sample->latency = latency;
+	sample->empty_buffer = empty_buffer;
+	history->head = (history->head + 1) % MONITOR_HISTORY;
+	if (history->count < MONITOR_HISTORY)
+		history->count++;
+	if (empty_buffer)
+		history->empty_buffers++;
+	history->configured_latency = configured_latency;
+
+	/* a quarter either way counts as moving */
+	if (history->count > 1 &&
+	    (latency > previous + previous / 4 ||
+	     latency < previous - previous / 4)) {
+		history->interval /= 2;
+		if (history->interval < MONITOR_MIN_INTERVAL)
+			history->interval = MONITOR_MIN_INTERVAL;
+	} else {
+		history->interval *= 2;
+		if (history->interval > MONITOR_MAX_INTERVAL)
+			history->interval = MONITOR_MAX_INTERVAL;
+	}
+	history->due = monotonic_usec() / 1000 + history->interval;
+
+	update_flags();
+}
+
+/* the server said something about the device: a parked one is sampled
+   again at once, and a new one gets its first sample */
+void wake_monitor(PulseDevice *device)
+{
+	if (!monitoring)
+		return;
+
+	if (device->history && device->history->parked) {
+		device->history->parked = False;
+		device->history->interval = MONITOR_MIN_INTERVAL;
+		device->history->due = 0;
+	}
+	schedule_monitor();
+}
+
+pa_usec_t mean_latency(MonitorHistory *history)
+{
+	int i;
+	pa_usec_t sum;
+
+	if (history->count == 0)
+		return 0;
+
+	sum = 0;
+	for (i = 0; i < history->count; i++)
+		sum += history->samples[i].latency;
+
+	return sum / history->count;
+}
+
+/* what was asked for or, for a stream whose sink or source hasn't been
+   sampled, the lowest latency it has shown */
+pa_usec_t reference_latency(MonitorHistory *history)
+{
+	int i;
+	pa_usec_t lowest;
+
+	if (history->configured_latency > 0)
+		return history->configured_latency;
+	if (history->count < MONITOR_BASELINE)
+		return 0;
+
+	lowest = history->samples[0].latency;
+	for (i = 1; i < history->count; i++)
+		if (history->samples[i].latency < lowest)
+			lowest = history->samples[i].latency;
+
+	return lowest;
+}
+
+Bool latency_too_high(MonitorHistory *history)
+{
+	pa_usec_t reference;
+
+	reference = reference_latency(history);
+	return reference > 0 && mean_latency(history) > 2 * reference;
+}
+
+/* of the samples kept, the share found with nothing buffered */
+int empty_percent(MonitorHistory *history)
+{
+	int i, empty;
+
+	if (history->count == 0)
+		return 0;
+
+	empty = 0;
+	for (i = 0; i < history->count; i++)
+		if (history->samples[i].empty_buffer)
+			empty++;
+
+	return empty * 100 / history->count;
+}
+
+/* milliseconds of latency well over the reference, plus the percentage
+   of empty buffers for a stream found empty more often than not; zero
+   for a device that is behaving */
+uint64_t get_score(MonitorHistory *history)
+{
+	int empty;
+	uint64_t score;
+
+	score = 0;
+	if (latency_too_high(history))
+		score = mean_latency(history) / PA_USEC_PER_MSEC;
+
+	empty = empty_percent(history);
+	if (empty > 50)
+		score += empty;
+
+	return score;
+}
+
+void update_flags(void)
+{
+	int i, j, k;
+	uint64_t score, worst_score[MONITOR_WORST];
+	WMArray *devices;
+	PulseDevice *device;
+	MonitorHistory *worst[MONITOR_WORST];
+	Bool flagged, changed;
+
+	for (i = 0; i < MONITOR_WORST; i++) {
+		worst[i] = NULL;
+		worst_score[i] = 0;
+	}
+
+	devices = get_devices();
+	for (i = 0; i < WMGetArrayItemCount(devices); i++) {
+		device = WMGetFromArray(devices, i);
+		if (!device->history)
+			continue;
+
+		score = get_score(device->history);
+		for (j = 0; j < MONITOR_WORST; j++)
+			if (score > worst_score[j])
+				break;
+		if (j == MONITOR_WORST)
+			continue;
+
+		for (k = MONITOR_WORST - 1; k > j; k--) {
+			worst[k] = worst[k - 1];
+			worst_score[k] = worst_score[k - 1];
+		}
+		worst[j] = device->history;
+		worst_score[j] = score;
+	}
+
+	changed = False;
+	for (i = 0; i < WMGetArrayItemCount(devices); i++) {
+		device = WMGetFromArray(devices, i);
+		if (!device->history)
+			continue;
+
+		flagged = False;
+		for (j = 0; j < MONITOR_WORST; j++)
+			if (worst[j] == device->history)
+				flagged = True;
+		if (flagged != device->history->flagged)
+			changed = True;
+		device->history->flagged = flagged;
+	}
+
+	if (changed)
+		update_dockapps();
+}
+
+/* for a device that is among the worst, its mean latency in
+   milliseconds or, if it is flagged for starving, its share of empty
+   buffers */
+Bool format_monitor_flag(PulseDevice *device, char *buf, size_t size)
+{
+	if (!device->history || !device->history->flagged)
+		return False;
+
+	if (latency_too_high(device->history))
+		snprintf(buf, size, "%llu",
+			 (unsigned long long)(mean_latency(device->history) /
+					      PA_USEC_PER_MSEC));
+	else
+		snprintf(buf, size, "%d%%", empty_percent(device->history));
+
+	return True;
+}
+
+void write_json_string(FILE *fp, const char *str)
+{
+	fputc('"', fp);
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			fprintf(fp, "\\%c", *str);
+		else if ((unsigned char)*str < 0x20)
+			fprintf(fp, "\\u%04x", *str);
+		else
+			fputc(*str, fp);
+	}
+	fputc('"', fp);
+}
+
+/* appended to the stats dump: every sampled device's history, oldest
+   sample first */
+void dump_monitor(FILE *fp)
+{
+	int i, j, n, first;
+	WMArray *devices;
+	PulseDevice *device;
+	MonitorHistory *history;
+	MonitorSample *sample;
+
+	if (!monitoring)
+		return;
+
+	fprintf(fp, ",\n  \"monitor\": [");
+	devices = get_devices();
+	first = 1;
+	for (i = 0; i < WMGetArrayItemCount(devices); i++) {
+		device = WMGetFromArray(devices, i);
+		history = device->history;
+		if (!history)
+			continue;
+
+		fprintf(fp, "%s\n    {\"server\": %d, \"type\": \"%s\", "
+			"\"name\": ", first ? "" : ",",
+			device->server->number,
+			monitor_type_names[device->type]);
+		write_json_string(fp, device->name);
+		fprintf(fp, ", \"interval_ms\": %d, \"parked\": %s, "
+			"\"flagged\": %s, \"empty_buffers\": %llu, "
+			"\"configured_latency_us\": %llu, \"samples\": [",
+			history->interval,
+			history->parked ? "true" : "false",
+			history->flagged ? "true" : "false",
+			(unsigned long long)history->empty_buffers,
+			(unsigned long long)history->configured_latency);
+
+		/* [time_ms, latency_us, empty_buffer] */
+		n = (history->head + MONITOR_HISTORY - history->count) %
+			MONITOR_HISTORY;
+		for (j = 0; j < history->count; j++) {
+			sample = &history->samples[(n + j) % MONITOR_HISTORY];
+			fprintf(fp, "%s[%u, %llu, %d]", j ? ", " : "",
+				sample->time,
+				(unsigned long long)sample->latency,
+				sample->empty_buffer ? 1 : 0);
+		}
+		fprintf(fp, "]}");
+		first = 0;
+	}
+	fprintf(fp, "\n  ]");
+}
@@ -0,0 +1,35 @@
+/* wmpmixer - PulseAudio mixer as a Window Maker dockapp
+ * Copyright (C) 2021 Doug Torrance <dtorrance@piedmont.edu>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <WINGs/WINGs.h>
+
+#include "pulse.h"
+
+void setup_monitor(void);
+void start_monitor(PulseServer *server);
+void wake_monitor(PulseDevice *device);
+Bool format_monitor_flag(PulseDevice *device, char *buf, size_t size);
+void dump_monitor(FILE *fp);
+
+#endif
@@ -0,0 +1,439 @@
+/* wmpmixer - PulseAudio mixer as a Window Maker dockapp
+ * Copyright (C) 2021 Doug Torrance <dtorrance@piedmont.edu>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include "profile.h"
+#include "pulse.h"
+
+#include <pulse/volume.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <WINGs/WUtil.h>
+
+/* Profiles live in the WINGs defaults domain for wmpmixer, e.g.
+ *
+ * {
+ *   Profiles = {
+ *     meeting = {
+ *       DefaultSink = "alsa_output.usb-headset";
+ *       DefaultSource = "alsa_input.usb-headset";
+ *       Devices = (
+ *         {Type = sink; Name = "alsa_output.usb-headset";
+ *          Volume = (65536, 65536); Muted = No;},
+ *         {Server = "unix:/run/seat1/pulse/native"; Type = sink; ...},
+ *         ...
+ *       );
+ *       Servers = {
+ *         "unix:/run/seat1/pulse/native" = {DefaultSink = ...;};
+ *       };
+ *     };
+ *   };
+ * }
+ *
+ * Devices are matched by server, type and name (the sink or source name,
+ * or the application name for streams), never by index.  Entries without
+ * a Server, and the top-level defaults, belong to the default server. */
+
+const char *profile_to_save = NULL;
+const char *profile_to_load = NULL;
+
+const char *profile_type_names[] = {
+	"sink",
+	"source",
+	"sink-input",
+	"source-output"
+};
+
+char *get_profiles_path(void);
+WMPropList *get_value(WMPropList *dict, const char *key);
+void put_value(WMPropList *dict, const char *key, WMPropList *value);
+WMPropList *read_profiles(const char *path);
+WMPropList *device_to_plist(PulseDevice *device);
+Bool same_server(PulseServer *server, const char *address);
+void save_defaults(PulseServer *server, WMPropList *dict);
+int get_profile_type(const char *name);
+void restore_device(PulseBatch *batch, WMPropList *entry);
+void restore_default(PulseBatch *batch, PulseServer *server,
+		     pulse_type type, WMPropList *dict, const char *key);
+void profile_done(Bool ok, void *data);
+
+void set_profile_action(const char *save, const char *load)
+{
+	profile_to_save = save;
+	profile_to_load = load;
+}
+
+Bool has_profile_action(void)
+{
+	return profile_to_save || profile_to_load;
+}
+
+void run_profile_action(void)
+{
+	if (profile_to_save)
+		exit(save_profile(profile_to_save) ?
+		     EXIT_SUCCESS : EXIT_FAILURE);
+
+	if (profile_to_load &&
+	    !load_profile(profile_to_load, profile_done, NULL))
+		exit(EXIT_FAILURE);
+}
+
+void profile_done(Bool ok, void *data)
+{
+	(void)data;
+
+	if (!ok)
+		werror("some of the profile couldn't be restored");
+	exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+char *get_profiles_path(void)
+{
+	return wdefaultspathfordomain(PACKAGE_NAME);
+}
+
+WMPropList *read_profiles(const char *path)
+{
+	WMPropList *root;
+
+	root = WMReadPropListFromFile(path);
+	if (root && !WMIsPLDictionary(root)) {
+		wwarning("%s is not a dictionary, ignoring it", path);
+		WMReleasePropList(root);
+		root = NULL;
+	}
+	if (!root)
+		root = WMCreatePLDictionary(NULL, NULL);
+
+	return root;
+}
+
+/* the dictionary and array functions retain what they are given, so these
+   drop the references to the temporaries */
+WMPropList *get_value(WMPropList *dict, const char *key)
+{
+	WMPropList *plkey, *value;
+
+	plkey = WMCreatePLString(key);
+	value = WMGetFromPLDictionary(dict, plkey);
+	WMReleasePropList(plkey);
+
+	return value;
+}
+
+void put_value(WMPropList *dict, const char *key, WMPropList *value)
+{
+	WMPropList *plkey;
+
+	plkey = WMCreatePLString(key);
+	WMPutInPLDictionary(dict, plkey, value);
+	WMReleasePropList(plkey);
+	WMReleasePropList(value);
+}
+
+WMPropList *device_to_plist(PulseDevice *device)
+{
+	int i;
+	char buf[16];
+	WMPropList *volume, *channel, *entry;
+
+	volume = WMCreatePLArray(NULL);
+	for (i = 0; i < device->volume.channels; i++) {
+		snprintf(buf, sizeof(buf), "%u", device->volume.values[i]);
+		channel = WMCreatePLString(buf);
+		WMAddToPLArray(volume, channel);
+		WMReleasePropList(channel);
+	}
+
+	entry = WMCreatePLDictionary(NULL, NULL);
+	if (device->server->address)
+		put_value(entry, "Server",
+			  WMCreatePLString(device->server->address));
+	put_value(entry, "Type",
+		  WMCreatePLString(profile_type_names[device->type]));
+	put_value(entry, "Name", WMCreatePLString(device->name));
+	put_value(entry, "Volume", volume);
+	put_value(entry, "Muted",
+		  WMCreatePLString(device->muted ? "Yes" : "No"));
+
+	return entry;
+}
+
+Bool same_server(PulseServer *server, const char *address)
+{
+	if (!server->address || !address)
+		return !server->address && !address;
+
+	return strcmp(server->address, address) == 0;
+}
+
+void save_defaults(PulseServer *server, WMPropList *dict)
+{
+	const char *default_name;
+
+	default_name = get_default_device_name(server, PULSE_SINK);
+	if (default_name)
+		put_value(dict, "DefaultSink",
+			  WMCreatePLString(default_name));
+	default_name = get_default_device_name(server, PULSE_SOURCE);
+	if (default_name)
+		put_value(dict, "DefaultSource",
+			  WMCreatePLString(default_name));
+}
+
+Bool save_profile(const char *name)
+{
+	int i, j;
+	char *path;
+	Bool saved;
+	WMArray *devices;
+	PulseDevice *device, *other;
+	PulseServer *server;
+	WMPropList *root, *profiles, *profile, *list, *entry, *servers;
+
+	devices = get_devices();
+	list = WMCreatePLArray(NULL);
+	for (i = 0; i < WMGetArrayItemCount(devices); i++) {
+		device = WMGetFromArray(devices, i);
+
+		/* several streams from one application can only be told
+		   apart by index, so keep the first */
+		for (j = 0; j < i; j++) {
+			other = WMGetFromArray(devices, j);
+			if (other->server == device->server &&
+			    other->type == device->type &&
+			    strcmp(other->name, device->name) == 0)
+				break;
+		}
+		if (j < i)
+			continue;
+
+		entry = device_to_plist(device);
+		WMAddToPLArray(list, entry);
+		WMReleasePropList(entry);
+	}
+
+	profile = WMCreatePLDictionary(NULL, NULL);
+	put_value(profile, "Devices", list);
+	servers = WMCreatePLDictionary(NULL, NULL);
+	for (i = 0; i < get_pulse_server_count(); i++) {
+		server = get_pulse_server(i);
+		if (!server->address) {
+			save_defaults(server, profile);
+			continue;
+		}
+
+		entry = WMCreatePLDictionary(NULL, NULL);
+		save_defaults(server, entry);
+		put_value(servers, server->address, entry);
+	}
+	if (WMGetPropListItemCount(servers) > 0)
+		put_value(profile, "Servers", servers);
+	else
+		WMReleasePropList(servers);
+
+	path = get_profiles_path();
+	root = read_profiles(path);
+	profiles = get_value(root, "Profiles");
+	if (!profiles || !WMIsPLDictionary(profiles)) {
+		/* root keeps it alive after put_value() */
+		profiles = WMCreatePLDictionary(NULL, NULL);
+		put_value(root, "Profiles", profiles);
+	}
+	put_value(profiles, name, profile);
+
+	saved = WMWritePropListToFile(root, path);
+	if (!saved)
+		werror("unable to save profile '%s' to %s", name, path);
+
+	WMReleasePropList(root);
+	wfree(path);
+
+	return saved;
+}
+
+int get_profile_type(const char *name)
+{
+	int i;
+
+	for (i = 0; i < 4; i++)
+		if (strcmp(profile_type_names[i], name) == 0)
+			return i;
+
+	return -1;
+}
+
+/* queue whatever it takes to bring the matching devices in line with
+   one saved entry; devices that already match cost nothing */
+void restore_device(PulseBatch *batch, WMPropList *entry)
+{
+	int i, j, type, channels;
+	unsigned long sum;
+	const char *name, *address;
+	WMArray *devices;
+	PulseDevice *device;
+	WMPropList *value, *volume_list;
+	pa_volume_t saved[PA_CHANNELS_MAX];
+	pa_cvolume volume;
+	Bool muted;
+
+	if (!WMIsPLDictionary(entry))
+		return;
+
+	value = get_value(entry, "Server");
+	address = value && WMIsPLString(value) ?
+		WMGetFromPLString(value) : NULL;
+
+	value = get_value(entry, "Type");
+	if (!value || !WMIsPLString(value) ||
+	    (type = get_profile_type(WMGetFromPLString(value))) < 0)
+		return;
+
+	value = get_value(entry, "Name");
+	if (!value || !WMIsPLString(value))
+		return;
+	name = WMGetFromPLString(value);
+
+	value = get_value(entry, "Muted");
+	muted = value && WMIsPLString(value) &&
+		strcmp(WMGetFromPLString(value), "Yes") == 0;
+
+	sum = 0;
+	channels = 0;
+	volume_list = get_value(entry, "Volume");
+	if (volume_list && WMIsPLArray(volume_list)) {
+		channels = WMGetPropListItemCount(volume_list);
+		if (channels > (int)PA_CHANNELS_MAX)
+			channels = PA_CHANNELS_MAX;
+		for (i = 0; i < channels; i++) {
+			value = WMGetFromPLArray(volume_list, i);
+			saved[i] = WMIsPLString(value) ?
+				strtoul(WMGetFromPLString(value), NULL, 10) :
+				PA_VOLUME_NORM;
+			if (saved[i] > 1.5 * PA_VOLUME_NORM)
+				saved[i] = 1.5 * PA_VOLUME_NORM;
+			sum += saved[i];
+		}
+	}
+
+	devices = get_devices();
+	for (i = 0; i < WMGetArrayItemCount(devices); i++) {
+		device = WMGetFromArray(devices, i);
+		if (!same_server(device->server, address) ||
+		    (int)device->type != type ||
+		    strcmp(device->name, name) != 0)
+			continue;
+
+		if (channels > 0) {
+			/* the channel map may have changed since the profile
+			   was saved, in which case keep the overall level */
+			if (channels == device->volume.channels) {
+				volume.channels = channels;
+				for (j = 0; j < channels; j++)
+					volume.values[j] = saved[j];
+			} else {
+				pa_cvolume_set(&volume,
+					       device->volume.channels,
+					       sum / channels);
+			}
+
+			if (!pa_cvolume_equal(&volume, &device->volume)) {
+				device->volume = volume;
+				batch_add_volume(batch, device);
+			}
+		}
+
+		if (device->muted != muted) {
+			device->muted = muted;
+			batch_add_muted(batch, device);
+		}
+	}
+}
+
+void restore_default(PulseBatch *batch, PulseServer *server,
+		     pulse_type type, WMPropList *dict, const char *key)
+{
+	const char *current, *name;
+	WMPropList *value;
+
+	value = get_value(dict, key);
+	if (!value || !WMIsPLString(value))
+		return;
+
+	name = WMGetFromPLString(value);
+	current = get_default_device_name(server, type);
+	if (current && strcmp(current, name) == 0)
+		return;
+
+	batch_add_default(batch, server, type, name);
+}
+
+/* done() is only called once the server has answered every change,
+   and told whether all of them were made */
+Bool load_profile(const char *name, void (*done)(Bool ok, void *data),
+		  void *data)
+{
+	int i;
+	char *path;
+	PulseBatch *batch;
+	PulseServer *server;
+	WMPropList *root, *profiles, *profile, *list, *servers, *dict;
+
+	path = get_profiles_path();
+	root = read_profiles(path);
+	wfree(path);
+
+	profiles = get_value(root, "Profiles");
+	profile = NULL;
+	if (profiles && WMIsPLDictionary(profiles))
+		profile = get_value(profiles, name);
+	if (!profile || !WMIsPLDictionary(profile)) {
+		werror("no profile named '%s'", name);
+		WMReleasePropList(root);
+		return False;
+	}
+
+	/* everything goes out in one burst on the existing connections */
+	batch = create_batch(done, data);
+	servers = get_value(profile, "Servers");
+	for (i = 0; i < get_pulse_server_count(); i++) {
+		server = get_pulse_server(i);
+		dict = profile;
+		if (server->address)
+			dict = servers && WMIsPLDictionary(servers) ?
+				get_value(servers, server->address) : NULL;
+		if (!dict || !WMIsPLDictionary(dict))
+			continue;
+
+		restore_default(batch, server, PULSE_SINK, dict,
+				"DefaultSink");
+		restore_default(batch, server, PULSE_SOURCE, dict,
+				"DefaultSource");
+	}
+	list = get_value(profile, "Devices");
+	if (list && WMIsPLArray(list))
+		for (i = 0; i < WMGetPropListItemCount(list); i++)
+			restore_device(batch, WMGetFromPLArray(list, i));
+	finish_batch(batch);
+
+	WMReleasePropList(root);
+
+	return True;
+}
@@ -17,52 +17,125 @@
  * USA.
  */
 
+#include "monitor.h"
+#include "profile.h"
 #include "pulse.h"
+#include "stats.h"
+#include "trace.h"
 #include "wmpmixer.h"
 
-#include <glib-object.h>
-#include <gtk/gtk.h>
 #include <pulse/context.h>
 #include <pulse/def.h>
+#include <pulse/error.h>
 #include <pulse/introspect.h>
 #include <pulse/mainloop-api.h>
 #include <pulse/mainloop.h>
+#include <pulse/operation.h>
 #include <pulse/proplist.h>
+#include <pulse/subscribe.h>
+#include <pulse/timeval.h>
 #include <pulse/volume.h>
+#include <poll.h>
 #include <stdint.h>
 #include <stdlib.h>
-#include <WINGs/WINGs.h>
+#include <string.h>
 #include <WINGs/WUtil.h>
-#include <wraster.h>
-#include <X11/Xlib.h>
+
+/* a lost server is tried again after a second, then less and less
+   often */
+#define RETRY_MIN_MS 1000
+#define RETRY_MAX_MS 60000
 
 pa_mainloop *ml;
-pa_context *ctx;
 
-typedef enum {
-	PULSE_SINK,
-	PULSE_SOURCE,
-	PULSE_SINK_INPUT,
-	PULSE_SOURCE_OUTPUT
-} pulse_type;
+/* with the dockapp, WINGs owns the main loop and waits on PulseAudio's
+   file descriptors and timeout on its behalf */
+Bool pulse_watched = False;
+struct pollfd *watched_fds = NULL;
+WMHandlerID *watched_handlers = NULL;
+unsigned long watched_count = 0;
+int watched_timeout = -1;
+WMHandlerID pulse_timer = NULL;
+WMHandlerID pulse_idle = NULL;
 
 typedef struct {
-	pulse_type type;
-	uint32_t index;
-	const char *description;
-	WMPixmap *icon;
-	pa_cvolume volume;
-	Bool muted;
-} PulseDevice;
-
-int current_device = 0;
+	const char *name;
+	unsigned int mask;
+} PulseGroup;
+
+/* a burst of operations sent together, with one redraw once all of them
+   have completed */
+struct PulseBatch {
+	int pending;
+	/* a request failed, or couldn't be sent */
+	Bool failed;
+	void (*done)(Bool ok, void *data);
+	void *data;
+};
+
+/* a request waiting for its reply: what to update once it comes in */
+typedef struct {
+	PulseServer *server;
+	trace_op kind;
+	/* the device, or the batch */
+	void *target;
+	/* for timing the reply, 0 if it isn't timed */
+	uint64_t sent_at;
+	/* for a new default sink or source, its name, only cached once the
+	   server has accepted it */
+	pulse_type default_type;
+	char *default_name;
+} PulseRequest;
+
+/* the devices one dockapp (or the control socket) shows, and which of
+   them is current */
+struct PulseSelection {
+	unsigned int group;
+	char *app_name;
+	int current;
+};
+
+WMArray *pulse_servers = NULL;
 WMArray *pulse_devices;
-
-PulseDevice *create_device(pulse_type type, uint32_t index,
+/* every selection, so they can be kept pointing at the right device */
+WMArray *pulse_selections = NULL;
+/* servers whose device lists haven't come in yet */
+int servers_loading = 0;
+
+PulseGroup pulse_groups[] = {
+	{"sinks", PULSE_GROUP(PULSE_SINK)},
+	{"sources", PULSE_GROUP(PULSE_SOURCE)},
+	{"streams", PULSE_GROUP(PULSE_SINK_INPUT)},
+	{"recordings", PULSE_GROUP(PULSE_SOURCE_OUTPUT)},
+	{"apps", PULSE_GROUP(PULSE_SINK_INPUT) |
+		 PULSE_GROUP(PULSE_SOURCE_OUTPUT)},
+	{"all", PULSE_GROUP(PULSE_SINK) | PULSE_GROUP(PULSE_SOURCE) |
+		PULSE_GROUP(PULSE_SINK_INPUT) |
+		PULSE_GROUP(PULSE_SOURCE_OUTPUT)},
+	{NULL, 0}
+};
+
+void connect_server(PulseServer *server, pa_mainloop_api *mlapi);
+void schedule_reconnect(PulseServer *server);
+void reconnect_cb(pa_mainloop_api *api, pa_time_event *event,
+		  const struct timeval *tv, void *userdata);
+PulseDevice *create_device(PulseServer *server, pulse_type type,
+			   uint32_t index, const char *name,
 			   const char *description, const char *icon_name,
 			   pa_cvolume volume, Bool muted);
-WMPixmap *icon_name_to_pixmap(const char *icon_name);
+void remove_device(int n);
+void destroy_device(PulseDevice *device);
+void update_device(PulseDevice *device, const char *name,
+		   const char *description, const char *icon_name,
+		   pa_cvolume volume, Bool muted);
+Bool same_string(const char *a, const char *b);
+void replace_string(char **str, const char *value);
 void mainloop_iterate(void *data);
+void got_sink(PulseServer *server, const pa_sink_info *info);
+void got_source(PulseServer *server, const pa_source_info *info);
+void got_sink_input(PulseServer *server, const pa_sink_input_info *info);
+void got_source_output(PulseServer *server,
+		       const pa_source_output_info *info);
 void sink_info_cb(pa_context *ctx, const pa_sink_info *info,
 		      int eol, void *userdata);
 void source_info_cb(pa_context *ctx, const pa_source_info *info,
@@ -71,217 +144,911 @@ void sink_input_info_cb(pa_context *ctx, const pa_sink_input_info *info,
 			int eol, void *userdata);
 void source_output_info_cb(pa_context *ctx, const pa_source_output_info *info,
 			int eol, void *userdata);
+void server_info_cb(pa_context *ctx, const pa_server_info *info,
+		    void *userdata);
+void set_default_names(PulseServer *server, const pa_server_info *info);
 void state_cb(pa_context *c, void *userdata);
+void subscribe_cb(pa_context *ctx, pa_subscription_event_type_t t,
+		  uint32_t index, void *userdata);
+void server_changed_cb(pa_context *ctx, const pa_server_info *info,
+		       void *userdata);
+void sink_changed_cb(pa_context *ctx, const pa_sink_info *info,
+		     int eol, void *userdata);
+void source_changed_cb(pa_context *ctx, const pa_source_info *info,
+		       int eol, void *userdata);
+void sink_input_changed_cb(pa_context *ctx, const pa_sink_input_info *info,
+			   int eol, void *userdata);
+void source_output_changed_cb(pa_context *ctx,
+			      const pa_source_output_info *info, int eol,
+			      void *userdata);
 pa_volume_t int_to_volume(int n);
-int volume_to_int(pa_cvolume volume);
-void update_slider_cb(pa_context *ctx, int success, void *userdata);
-void update_muted_cb(pa_context *ctx, int success, void *userdata);
-void change_current_device_volume_by(int k);
-PulseDevice *get_current_device(void);
-
-WMPixmap *icon_name_to_pixmap(const char *icon_name) {
-	const char *file;
-	GtkIconTheme *theme;
-	GtkIconInfo *icon_info;
-	WMPixmap *pixmap;
-	WMScreen *screen;
-
-	RColor bg = {40, 40, 40, 255};
-
-	screen = get_screen();
-
-	if (!icon_name)
-		goto error;
-
-	theme = gtk_icon_theme_get_default();
-	if (!theme)
-		goto error;
-
-	icon_info = gtk_icon_theme_lookup_icon(
-		theme, icon_name, 22, GTK_ICON_LOOKUP_GENERIC_FALLBACK);
-	if (!icon_info)
-		goto error;
-
-	file = gtk_icon_info_get_filename(icon_info);
-
-	pixmap = WMCreateScaledBlendedPixmapFromFile(screen, file, &bg, 22, 22);
-
-	g_object_unref(icon_info);
-
-	return pixmap;
-
-error:
-	werror("unable to get icon");
-	return WMCreatePixmap(screen, 22, 22, 0, False);
-}
+Bool selection_matches(PulseSelection *selection, PulseDevice *device);
+void step_selection(PulseSelection *selection, int step);
+PulseRequest *create_request(PulseServer *server, trace_op kind,
+			     void *target);
+Bool track_request(PulseRequest *request, pa_operation *op);
+void request_cb(pa_context *ctx, int success, void *userdata);
+void finish_request(PulseRequest *request, Bool success);
+void set_default_name(PulseServer *server, pulse_type type,
+		      const char *name);
+Bool send_device_volume(PulseDevice *device, trace_op kind, void *target);
+Bool send_device_muted(PulseDevice *device, trace_op kind, void *target);
+void volume_done(PulseDevice *device);
+void release_batch(PulseBatch *batch, Bool success);
+int watch_poll(struct pollfd *ufds, unsigned long nfds, int timeout,
+	       void *userdata);
+void watch_fds(struct pollfd *ufds, unsigned long nfds);
+void pulse_input_cb(int fd, int mask, void *data);
+void pulse_timer_cb(void *data);
+void pulse_idle_cb(void *data);
+void wake_pulse_mainloop(void);
+void request_pulse_iteration(void);
 
 void setup_pulse(void)
 {
+	int i;
 	pa_mainloop_api *mlapi;
 
 	pulse_devices = WMCreateArray(0);
 
+	/* the trace stands in for the servers, and says which there were */
+	if (trace_replaying())
+		return;
+
+	if (get_pulse_server_count() == 0)
+		add_pulse_server(NULL);
+
+	/* every server's context runs on the same main loop */
 	ml = pa_mainloop_new();
 	if (!ml) {
 		werror("pa_mainloop_new() failed");
 		exit(EXIT_FAILURE);
 	}
 	mlapi = pa_mainloop_get_api(ml);
-	ctx = pa_context_new(mlapi, PACKAGE_NAME);
-	if (!ctx) {
+	for (i = 0; i < get_pulse_server_count(); i++)
+		connect_server(get_pulse_server(i), mlapi);
+}
+
+void add_pulse_server(const char *address)
+{
+	PulseServer *server;
+
+	if (!pulse_servers)
+		pulse_servers = WMCreateArray(1);
+
+	server = wmalloc(sizeof(PulseServer));
+	server->number = WMGetArrayItemCount(pulse_servers);
+	server->address = address ? wstrdup(address) : NULL;
+	server->ctx = NULL;
+	server->default_sink_name = NULL;
+	server->default_source_name = NULL;
+	server->loaded = False;
+	server->lost = False;
+	server->retry_ms = RETRY_MIN_MS;
+	server->requests = WMCreateArray(0);
+	WMAddToArray(pulse_servers, server);
+	servers_loading++;
+
+	trace_server(address);
+}
+
+void connect_server(PulseServer *server, pa_mainloop_api *mlapi)
+{
+	server->ctx = pa_context_new(mlapi, PACKAGE_NAME);
+	if (!server->ctx) {
 		werror("pa_context_new() failed");
 		exit(EXIT_FAILURE);
 	}
-	pa_context_connect(ctx, NULL, 0, NULL);
-	pa_context_set_state_callback(ctx, state_cb, NULL);
+	pa_context_set_state_callback(server->ctx, state_cb, server);
+	/* a server that can't be reached is reported by state_cb() */
+	pa_context_connect(server->ctx, server->address, 0, NULL);
+}
+
+/* on the PulseAudio main loop, so a headless wmpmixer reconnects too */
+void schedule_reconnect(PulseServer *server)
+{
+	struct timeval tv;
+	pa_mainloop_api *api;
+
+	api = pa_mainloop_get_api(ml);
+	pa_gettimeofday(&tv);
+	pa_timeval_add(&tv, (pa_usec_t)server->retry_ms * PA_USEC_PER_MSEC);
+	api->time_new(api, &tv, reconnect_cb, server);
+
+	server->retry_ms *= 2;
+	if (server->retry_ms > RETRY_MAX_MS)
+		server->retry_ms = RETRY_MAX_MS;
+}
+
+/* a context can't be connected twice, so the old one makes way for a
+   new one */
+void reconnect_cb(pa_mainloop_api *api, pa_time_event *event,
+		  const struct timeval *tv, void *userdata)
+{
+	PulseServer *server = userdata;
+
+	(void)tv;
+
+	api->time_free(event);
+
+	pa_context_set_state_callback(server->ctx, NULL, NULL);
+	pa_context_set_subscribe_callback(server->ctx, NULL, NULL);
+	pa_context_disconnect(server->ctx);
+	pa_context_unref(server->ctx);
+	connect_server(server, api);
+	request_pulse_iteration();
 }
 
-PulseDevice *create_device(pulse_type type, uint32_t index,
+PulseServer *get_pulse_server(int n)
+{
+	if (!pulse_servers || n < 0 ||
+	    n >= WMGetArrayItemCount(pulse_servers))
+		return NULL;
+
+	return WMGetFromArray(pulse_servers, n);
+}
+
+int get_pulse_server_count(void)
+{
+	return pulse_servers ? WMGetArrayItemCount(pulse_servers) : 0;
+}
+
+const char *get_server_name(PulseServer *server)
+{
+	return server->address ? server->address : "default";
+}
+
+PulseDevice *create_device(PulseServer *server, pulse_type type,
+			   uint32_t index, const char *name,
 			   const char *description, const char *icon_name,
 			   pa_cvolume volume, Bool muted)
 {
 	PulseDevice *device;
 
 	device = wmalloc(sizeof(PulseDevice));
+	STATS_COUNT(STAT_ALLOCATIONS);
+	device->server = server;
 	device->type = type;
 	device->index = index;
+	device->name = wstrdup(name);
+	STATS_COUNT(STAT_ALLOCATIONS);
 	device->description = wstrdup(description);
-	device->icon = icon_name_to_pixmap(icon_name);
+	STATS_COUNT(STAT_ALLOCATIONS);
+	device->icon_name = NULL;
+	if (icon_name) {
+		device->icon_name = wstrdup(icon_name);
+		STATS_COUNT(STAT_ALLOCATIONS);
+	}
+	device->icon = NULL;
 	device->volume = volume;
 	device->muted = muted;
+	device->volume_in_flight = False;
+	device->volume_pending = False;
+	device->volume_changed_at = 0;
+	device->volume_pending_at = 0;
+	device->history = NULL;
 
 	return device;
 }
 
+/* the selections showing later devices are moved down with them */
+void remove_device(int n)
+{
+	int i;
+	PulseDevice *device;
+	PulseSelection *selection;
+
+	device = WMGetFromArray(pulse_devices, n);
+	WMDeleteFromArray(pulse_devices, n);
+
+	for (i = 0; pulse_selections &&
+		     i < WMGetArrayItemCount(pulse_selections); i++) {
+		selection = WMGetFromArray(pulse_selections, i);
+		if (selection->current == n)
+			selection->current = -1;
+		else if (selection->current > n)
+			selection->current--;
+	}
 
-void sink_info_cb(pa_context *ctx, const pa_sink_info *info,
-		      int eol, void *userdata)
+	destroy_device(device);
+}
+
+/* the icon belongs to the cache */
+void destroy_device(PulseDevice *device)
 {
-	(void)userdata;
+	wfree((char *)device->name);
+	wfree((char *)device->description);
+	wfree(device->icon_name);
+	wfree(device->history);
+	wfree(device);
+}
+
+/* a device the server reports again, after a change, is updated in
+   place */
+void add_device(PulseServer *server, pulse_type type, uint32_t index,
+		const char *name, const char *description,
+		const char *icon_name, pa_cvolume volume, Bool muted)
+{
+	PulseDevice *device;
 
-	if (eol) {
-		pa_context_get_source_info_list(ctx, source_info_cb, NULL);
+	trace_device(server->number, type, index, name, description,
+		     icon_name, &volume, muted);
+	device = find_device(server, type, index);
+	if (device) {
+		update_device(device, name, description, icon_name, volume,
+			      muted);
 		return;
-	} else {
-		const char *icon_name;
-		PulseDevice *device;
+	}
 
-		icon_name = pa_proplist_gets(info->proplist,
-					     "device.icon_name");
-		device = create_device(PULSE_SINK, info->index,
-				       info->description, icon_name,
-				       info->volume, info->mute);
-		WMAddToArray(pulse_devices, device);
+	device = create_device(server, type, index, name, description,
+			       icon_name, volume, muted);
+	WMAddToArray(pulse_devices, device);
+	/* the first list is shown all at once, by devices_loaded() */
+	if (server->loaded) {
+		wake_monitor(device);
+		update_dockapps();
 	}
 }
 
-void source_info_cb(pa_context *ctx, const pa_source_info *info,
-		    int eol, void *userdata)
+void update_device(PulseDevice *device, const char *name,
+		   const char *description, const char *icon_name,
+		   pa_cvolume volume, Bool muted)
 {
-	(void)userdata;
+	if (!same_string(device->name, name) ||
+	    !same_string(device->description, description) ||
+	    !same_string(device->icon_name, icon_name)) {
+		replace_string((char **)&device->name, name);
+		replace_string((char **)&device->description, description);
+		if (!same_string(device->icon_name, icon_name)) {
+			replace_string(&device->icon_name, icon_name);
+			device->icon = NULL;
+		}
+		update_dockapps();
+	}
 
-	if (eol) {
-		pa_context_get_sink_input_info_list(ctx, sink_input_info_cb,
-						    NULL);
+	/* our own change is what counts until the server has answered it */
+	if (!device->volume_in_flight &&
+	    !pa_cvolume_equal(&volume, &device->volume)) {
+		device->volume = volume;
+		update_slider(device);
+	}
+
+	if (device->muted != muted) {
+		device->muted = muted;
+		update_muted(device);
+	}
+
+	wake_monitor(device);
+}
+
+Bool same_string(const char *a, const char *b)
+{
+	if (!a || !b)
+		return a == b;
+
+	return strcmp(a, b) == 0;
+}
+
+void replace_string(char **str, const char *value)
+{
+	if (*str)
+		wfree(*str);
+	*str = NULL;
+	if (value) {
+		*str = wstrdup(value);
+		STATS_COUNT(STAT_ALLOCATIONS);
+	}
+}
+
+PulseDevice *find_device(PulseServer *server, pulse_type type,
+			 uint32_t index)
+{
+	int i;
+	PulseDevice *device;
+
+	for (i = 0; i < WMGetArrayItemCount(pulse_devices); i++) {
+		device = WMGetFromArray(pulse_devices, i);
+		if (device->server == server && device->type == type &&
+		    device->index == index)
+			return device;
+	}
+
+	return NULL;
+}
+
+/* requests still waiting for their reply no longer update the device */
+void forget_device(PulseServer *server, pulse_type type, uint32_t index)
+{
+	int i, j;
+	PulseDevice *device;
+	PulseRequest *request;
+
+	trace_device_removed(server->number, type, index);
+
+	for (i = 0; i < WMGetArrayItemCount(pulse_devices); i++) {
+		device = WMGetFromArray(pulse_devices, i);
+		if (device->server == server && device->type == type &&
+		    device->index == index)
+			break;
+	}
+	if (i == WMGetArrayItemCount(pulse_devices))
 		return;
-	} else {
-		const char *icon_name;
-		PulseDevice *device;
 
-		icon_name = pa_proplist_gets(info->proplist,
-					     "device.icon_name");
-		device = create_device(PULSE_SOURCE, info->index,
-				       info->description, icon_name,
-				       info->volume, info->mute);
-		WMAddToArray(pulse_devices, device);
+	for (j = 0; j < WMGetArrayItemCount(server->requests); j++) {
+		request = WMGetFromArray(server->requests, j);
+		if (request->kind != TRACE_BATCH &&
+		    request->target == device)
+			request->target = NULL;
 	}
+	remove_device(i);
+	update_dockapps();
+}
+
+/* profiles wait for every server, so they see all the devices, but
+   only the first time: the list also comes in again after a reconnect */
+void devices_loaded(PulseServer *server)
+{
+	Bool first;
+
+	trace_list_done(server->number);
+	first = !server->loaded;
+	server->loaded = True;
+	server->lost = False;
+	start_monitor(server);
+	update_dockapps();
+	if (first && --servers_loading == 0)
+		run_profile_action();
+}
+
+void got_sink(PulseServer *server, const pa_sink_info *info)
+{
+	const char *icon_name;
+
+	icon_name = pa_proplist_gets(info->proplist, "device.icon_name");
+	add_device(server, PULSE_SINK, info->index, info->name,
+		   info->description, icon_name, info->volume, info->mute);
+}
+
+void got_source(PulseServer *server, const pa_source_info *info)
+{
+	const char *icon_name;
+
+	icon_name = pa_proplist_gets(info->proplist, "device.icon_name");
+	add_device(server, PULSE_SOURCE, info->index, info->name,
+		   info->description, icon_name, info->volume, info->mute);
+}
+
+void got_sink_input(PulseServer *server, const pa_sink_input_info *info)
+{
+	const char *name, *icon_name;
+
+	name = pa_proplist_gets(info->proplist, "application.name");
+	if (!name)
+		name = info->name;
+	icon_name = pa_proplist_gets(info->proplist,
+				     "application.icon_name");
+	add_device(server, PULSE_SINK_INPUT, info->index, name, name,
+		   icon_name, info->volume, info->mute);
+}
+
+void got_source_output(PulseServer *server,
+		       const pa_source_output_info *info)
+{
+	const char *name, *icon_name;
+
+	name = pa_proplist_gets(info->proplist, "application.name");
+	if (!name)
+		name = info->name;
+	icon_name = pa_proplist_gets(info->proplist,
+				     "application.icon_name");
+	add_device(server, PULSE_SOURCE_OUTPUT, info->index, name, name,
+		   icon_name, info->volume, info->mute);
+}
+
+/* the first list is fetched one kind of device after another */
+void sink_info_cb(pa_context *ctx, const pa_sink_info *info,
+		      int eol, void *userdata)
+{
+	if (eol)
+		pa_context_get_source_info_list(ctx, source_info_cb,
+						userdata);
+	else
+		got_sink(userdata, info);
+}
+
+void source_info_cb(pa_context *ctx, const pa_source_info *info,
+		    int eol, void *userdata)
+{
+	if (eol)
+		pa_context_get_sink_input_info_list(ctx, sink_input_info_cb,
+						    userdata);
+	else
+		got_source(userdata, info);
 }
 
 void sink_input_info_cb(pa_context *ctx, const pa_sink_input_info *info,
 			int eol, void *userdata)
 {
-	(void)userdata;
-
-	if (eol) {
+	if (eol)
 		pa_context_get_source_output_info_list(ctx,
 						       source_output_info_cb,
-						       NULL);
-		return;
-	} else {
-		const char *name, *icon_name;
-		PulseDevice *device;
-
-		name = pa_proplist_gets(info->proplist, "application.name");
-		icon_name = pa_proplist_gets(info->proplist,
-					     "application.icon_name");
-		device = create_device(PULSE_SINK_INPUT, info->index,
-				       name, icon_name, info->volume,
-				       info->mute);
-		WMAddToArray(pulse_devices, device);
-	}
+						       userdata);
+	else
+		got_sink_input(userdata, info);
 }
 
 void source_output_info_cb(pa_context *ctx, const pa_source_output_info *info,
 			int eol, void *userdata)
 {
 	(void)ctx;
-	(void)userdata;
 
-	if (eol) {
-		update_device();
-		return;
-	} else {
-		const char *name, *icon_name;
-		PulseDevice *device;
+	if (eol)
+		devices_loaded(userdata);
+	else
+		got_source_output(userdata, info);
+}
+
+void server_info_cb(pa_context *ctx, const pa_server_info *info,
+		    void *userdata)
+{
+	set_default_names(userdata, info);
+	pa_context_get_sink_info_list(ctx, sink_info_cb, userdata);
+}
 
-		name = pa_proplist_gets(info->proplist, "application.name");
-		icon_name = pa_proplist_gets(info->proplist,
-					     "application.icon_name");
-		device = create_device(PULSE_SOURCE_OUTPUT, info->index,
-				       name, icon_name, info->volume,
-				       info->mute);
-		WMAddToArray(pulse_devices, device);
+void set_default_names(PulseServer *server, const pa_server_info *info)
+{
+	wfree(server->default_sink_name);
+	wfree(server->default_source_name);
+	server->default_sink_name = NULL;
+	server->default_source_name = NULL;
+	if (info && info->default_sink_name) {
+		server->default_sink_name = wstrdup(info->default_sink_name);
+		STATS_COUNT(STAT_ALLOCATIONS);
+	}
+	if (info && info->default_source_name) {
+		server->default_source_name =
+			wstrdup(info->default_source_name);
+		STATS_COUNT(STAT_ALLOCATIONS);
 	}
 }
 
 void state_cb(pa_context *ctx, void *userdata) {
 	pa_context_state_t state;
-
-	(void)userdata;
+	pa_operation *op;
+	PulseServer *server = userdata;
 
         state = pa_context_get_state(ctx);
 	/* TODO - display this info on the dockapp in some way */
 
-	if (state == PA_CONTEXT_READY)
-		pa_context_get_sink_info_list(ctx, sink_info_cb, NULL);
+	if (state == PA_CONTEXT_READY) {
+		server->retry_ms = RETRY_MIN_MS;
+		/* subscribed before the list is fetched, so nothing that
+		   changes in between is missed */
+		pa_context_set_subscribe_callback(ctx, subscribe_cb, server);
+		op = pa_context_subscribe(ctx,
+					  PA_SUBSCRIPTION_MASK_SINK |
+					  PA_SUBSCRIPTION_MASK_SOURCE |
+					  PA_SUBSCRIPTION_MASK_SINK_INPUT |
+					  PA_SUBSCRIPTION_MASK_SOURCE_OUTPUT |
+					  PA_SUBSCRIPTION_MASK_SERVER,
+					  NULL, NULL);
+		if (op)
+			pa_operation_unref(op);
+		pa_context_get_server_info(ctx, server_info_cb, server);
+	} else if (state == PA_CONTEXT_FAILED ||
+		   state == PA_CONTEXT_TERMINATED) {
+		/* the other servers carry on without it while it is tried
+		   again; failed attempts after the first go unreported */
+		if (!server->lost) {
+			wwarning(server->loaded ? "lost the %s server: %s" :
+				 "unable to connect to the %s server: %s",
+				 get_server_name(server),
+				 pa_strerror(pa_context_errno(ctx)));
+			if (!server->loaded)
+				devices_loaded(server);
+			server_lost(server);
+		}
+		schedule_reconnect(server);
+	}
 }
 
-void iterate_pulse_mainloop(void *data)
+/* keep the device list as the server has it: new and changed devices
+   are fetched again, removed ones dropped */
+void subscribe_cb(pa_context *ctx, pa_subscription_event_type_t t,
+		  uint32_t index, void *userdata)
 {
-	(void)data;
+	pa_operation *op;
+	pulse_type type;
+	PulseServer *server = userdata;
+
+	switch (t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK) {
+	case PA_SUBSCRIPTION_EVENT_SERVER:
+		op = pa_context_get_server_info(ctx, server_changed_cb,
+						server);
+		if (op)
+			pa_operation_unref(op);
+		return;
+
+	case PA_SUBSCRIPTION_EVENT_SINK:
+		type = PULSE_SINK;
+		break;
+
+	case PA_SUBSCRIPTION_EVENT_SOURCE:
+		type = PULSE_SOURCE;
+		break;
+
+	case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+		type = PULSE_SINK_INPUT;
+		break;
+
+	case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+		type = PULSE_SOURCE_OUTPUT;
+		break;
+
+	default:
+		return;
+	}
 
-	pa_mainloop_iterate(ml, 0, NULL);
+	if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) ==
+	    PA_SUBSCRIPTION_EVENT_REMOVE) {
+		forget_device(server, type, index);
+		return;
+	}
+
+	switch (type) {
+	case PULSE_SINK:
+		op = pa_context_get_sink_info_by_index(ctx, index,
+						       sink_changed_cb,
+						       server);
+		break;
+
+	case PULSE_SOURCE:
+		op = pa_context_get_source_info_by_index(ctx, index,
+							 source_changed_cb,
+							 server);
+		break;
+
+	case PULSE_SINK_INPUT:
+		op = pa_context_get_sink_input_info(ctx, index,
+						    sink_input_changed_cb,
+						    server);
+		break;
+
+	case PULSE_SOURCE_OUTPUT:
+		op = pa_context_get_source_output_info(
+			ctx, index, source_output_changed_cb, server);
+		break;
+
+	default:
+		op = NULL;
+		break;
+	}
+	if (op)
+		pa_operation_unref(op);
+}
+
+void server_changed_cb(pa_context *ctx, const pa_server_info *info,
+		       void *userdata)
+{
+	(void)ctx;
+
+	if (info)
+		set_default_names(userdata, info);
+}
+
+/* a device that went away before it could be fetched is dropped by its
+   removal event */
+void sink_changed_cb(pa_context *ctx, const pa_sink_info *info,
+		     int eol, void *userdata)
+{
+	(void)ctx;
+
+	if (!eol)
+		got_sink(userdata, info);
+}
+
+void source_changed_cb(pa_context *ctx, const pa_source_info *info,
+		       int eol, void *userdata)
+{
+	(void)ctx;
+
+	if (!eol)
+		got_source(userdata, info);
+}
+
+void sink_input_changed_cb(pa_context *ctx, const pa_sink_input_info *info,
+			   int eol, void *userdata)
+{
+	(void)ctx;
+
+	if (!eol)
+		got_sink_input(userdata, info);
 }
 
-PulseDevice *get_current_device(void)
+void source_output_changed_cb(pa_context *ctx,
+			      const pa_source_output_info *info, int eol,
+			      void *userdata)
 {
-	return WMGetFromArray(pulse_devices, current_device);
+	(void)ctx;
+
+	if (!eol)
+		got_source_output(userdata, info);
 }
 
-const char *get_current_device_description(void)
+/* The context drops its outstanding requests without calling back, so
+ * they are finished off here, as if they had failed, before the server's
+ * devices go.  Nothing more is sent to it until devices_loaded() says it
+ * is back. */
+void server_lost(PulseServer *server)
 {
+	int i;
 	PulseDevice *device;
+	PulseRequest *request;
+
+	trace_server_lost(server->number);
+	server->lost = True;
+
+	while (WMGetArrayItemCount(server->requests) > 0) {
+		request = WMGetFromArray(server->requests, 0);
+		WMDeleteFromArray(server->requests, 0);
+		finish_request(request, False);
+	}
+
+	for (i = WMGetArrayItemCount(pulse_devices) - 1; i >= 0; i--) {
+		device = WMGetFromArray(pulse_devices, i);
+		if (device->server == server)
+			remove_device(i);
+	}
+
+	update_dockapps();
+}
+
+pa_mainloop_api *get_pulse_mainloop_api(void)
+{
+	return pa_mainloop_get_api(ml);
+}
+
+/* hand the waiting over to WINGs: a request goes out as soon as the
+   event that made it has been handled, and a reply is read as soon as
+   it arrives */
+void watch_pulse_mainloop(void)
+{
+	pulse_watched = True;
+	pa_mainloop_set_poll_func(ml, watch_poll, NULL);
+	wake_pulse_mainloop();
+}
 
-	device = get_current_device();
-	return device->description;
+/* WINGs does the waiting, so only look at what is ready now, and
+   remember what to wait for next */
+int watch_poll(struct pollfd *ufds, unsigned long nfds, int timeout,
+	       void *userdata)
+{
+	(void)userdata;
+
+	watch_fds(ufds, nfds);
+	watched_timeout = timeout;
+
+	return poll(ufds, nfds, 0);
+}
+
+/* the descriptors rarely change, so the input handlers are only
+   replaced when they do */
+void watch_fds(struct pollfd *ufds, unsigned long nfds)
+{
+	unsigned long i;
+	int mask;
+
+	if (nfds == watched_count) {
+		for (i = 0; i < nfds; i++)
+			if (ufds[i].fd != watched_fds[i].fd ||
+			    ufds[i].events != watched_fds[i].events)
+				break;
+		if (i == nfds)
+			return;
+	}
+
+	for (i = 0; i < watched_count; i++)
+		WMDeleteInputHandler(watched_handlers[i]);
+	if (watched_count > 0) {
+		wfree(watched_fds);
+		wfree(watched_handlers);
+	}
+	watched_count = nfds;
+	if (nfds == 0)
+		return;
+
+	watched_fds = wmalloc(nfds * sizeof(struct pollfd));
+	memcpy(watched_fds, ufds, nfds * sizeof(struct pollfd));
+	watched_handlers = wmalloc(nfds * sizeof(WMHandlerID));
+	for (i = 0; i < nfds; i++) {
+		mask = 0;
+		if (ufds[i].events & POLLIN)
+			mask |= WIReadMask;
+		if (ufds[i].events & POLLOUT)
+			mask |= WIWriteMask;
+		if (ufds[i].events & POLLPRI)
+			mask |= WIExceptMask;
+		watched_handlers[i] = WMAddInputHandler(
+			ufds[i].fd, mask, pulse_input_cb, NULL);
+	}
+}
+
+void pulse_input_cb(int fd, int mask, void *data)
+{
+	(void)fd;
+	(void)mask;
+	(void)data;
+
+	wake_pulse_mainloop();
+}
+
+void pulse_timer_cb(void *data)
+{
+	(void)data;
+
+	pulse_timer = NULL;
+	wake_pulse_mainloop();
+}
+
+void pulse_idle_cb(void *data)
+{
+	(void)data;
+
+	pulse_idle = NULL;
+	wake_pulse_mainloop();
 }
 
-WMPixmap *get_current_device_icon(void)
+void wake_pulse_mainloop(void)
 {
+	int dispatched;
+
+	STATS_COUNT(STAT_MAINLOOP_ITERATIONS);
+	dispatched = pa_mainloop_iterate(ml, 1, NULL);
+	poll_stats();
+	poll_trace();
+	if (dispatched < 0)
+		return;
+
+	if (pulse_timer) {
+		WMDeleteTimerHandler(pulse_timer);
+		pulse_timer = NULL;
+	}
+	/* the timeout was worked out before dispatching, and whatever was
+	   dispatched may have queued more work, so look again once WINGs
+	   is idle */
+	if (dispatched > 0 || watched_timeout == 0)
+		request_pulse_iteration();
+	else if (watched_timeout > 0)
+		pulse_timer = WMAddTimerHandler(watched_timeout,
+						pulse_timer_cb, NULL);
+}
+
+/* libpulse sends queued requests from the main loop, so run it once the
+   current event has been handled */
+void request_pulse_iteration(void)
+{
+	if (pulse_watched && !pulse_idle)
+		pulse_idle = WMAddIdleHandler(pulse_idle_cb, NULL);
+}
+
+/* with no X connection there is nothing else to wait on, so block in
+   the PulseAudio main loop; a signal wakes it up for poll_stats() */
+void run_pulse_mainloop(void)
+{
+	for (;;) {
+		STATS_COUNT(STAT_MAINLOOP_ITERATIONS);
+		if (pa_mainloop_iterate(ml, 1, NULL) < 0)
+			break;
+		poll_stats();
+		poll_trace();
+	}
+}
+
+WMArray *get_devices(void)
+{
+	return pulse_devices;
+}
+
+const char *get_default_device_name(PulseServer *server, pulse_type type)
+{
+	return type == PULSE_SINK ? server->default_sink_name :
+		server->default_source_name;
+}
+
+PulseSelection *create_selection(const char *filter)
+{
+	unsigned int group;
+	PulseSelection *selection;
+
+	if (strncmp(filter, "app:", 4) == 0)
+		group = get_group("apps");
+	else
+		group = get_group(filter);
+	if (!group)
+		return NULL;
+
+	selection = wmalloc(sizeof(PulseSelection));
+	selection->group = group;
+	selection->app_name = NULL;
+	if (strncmp(filter, "app:", 4) == 0)
+		selection->app_name = wstrdup(filter + 4);
+	selection->current = -1;
+
+	if (!pulse_selections)
+		pulse_selections = WMCreateArray(0);
+	WMAddToArray(pulse_selections, selection);
+
+	return selection;
+}
+
+Bool selection_matches(PulseSelection *selection, PulseDevice *device)
+{
+	if (!(selection->group & PULSE_GROUP(device->type)))
+		return False;
+
+	return !selection->app_name ||
+		strcmp(selection->app_name, device->name) == 0;
+}
+
+/* the first matching device until another one is picked, or NULL if
+   nothing matches */
+PulseDevice *get_selected_device(PulseSelection *selection)
+{
+	int i;
 	PulseDevice *device;
 
-	device = WMGetFromArray(pulse_devices, current_device);
-	return device->icon;
+	if (selection->current >= 0)
+		return WMGetFromArray(pulse_devices, selection->current);
+
+	for (i = 0; i < WMGetArrayItemCount(pulse_devices); i++) {
+		device = WMGetFromArray(pulse_devices, i);
+		if (selection_matches(selection, device)) {
+			selection->current = i;
+			return device;
+		}
+	}
+
+	return NULL;
+}
+
+void step_selection(PulseSelection *selection, int step)
+{
+	int i, n, count;
+
+	if (!get_selected_device(selection))
+		return;
+
+	count = WMGetArrayItemCount(pulse_devices);
+	n = selection->current;
+	for (i = 0; i < count; i++) {
+		n = (n + step + count) % count;
+		if (selection_matches(selection,
+				      WMGetFromArray(pulse_devices, n))) {
+			selection->current = n;
+			return;
+		}
+	}
+}
+
+void select_next_device(PulseSelection *selection)
+{
+	step_selection(selection, 1);
+}
+
+void select_previous_device(PulseSelection *selection)
+{
+	step_selection(selection, -1);
+}
+
+/* n is the device's position in get_devices() */
+Bool select_device(PulseSelection *selection, int n)
+{
+	if (n < 0 || n >= WMGetArrayItemCount(pulse_devices) ||
+	    !selection_matches(selection, WMGetFromArray(pulse_devices, n)))
+		return False;
+
+	selection->current = n;
+	return True;
 }
 
 /* returns an int between 0 (= muted) and 25 (= 150% of normal) */
@@ -302,21 +1069,6 @@ int volume_to_int(pa_cvolume volume)
 		return result;
 }
 
-int get_current_device_volume(void)
-{
-	PulseDevice *device;
-
-	device = get_current_device();
-	return volume_to_int(device->volume);
-}
-
-Bool get_current_device_muted(void)
-{
-	PulseDevice *device;
-
-	device = get_current_device();
-	return device->muted;
-}
 pa_volume_t int_to_volume(int n)
 {
 	pa_volume_t result;
@@ -332,22 +1084,10 @@ pa_volume_t int_to_volume(int n)
 		return result;
 }
 
-void increment_current_device_volume(void)
-{
-	change_current_device_volume_by(1);
-}
-
-void decrement_current_device_volume(void)
-{
-	change_current_device_volume_by(-1);
-}
-
-void change_current_device_volume_by(int k)
+void change_device_volume_by(PulseDevice *device, int k)
 {
 	int n;
-	PulseDevice *device;
 
-	device = get_current_device();
 	n = volume_to_int(device->volume) + k;
 
 	if (n < 0)
@@ -355,133 +1095,477 @@ void change_current_device_volume_by(int k)
 	else if (n > 25)
 		n = 25;
 
-	set_current_device_volume(n);
+	set_device_volume(device, n);
 }
 
-void set_current_device_volume(int n)
+void set_device_volume(PulseDevice *device, int n)
 {
-	int i;
-	PulseDevice *device;
-	pa_cvolume volume;
-	pa_volume_t channel_volume;
+	pa_cvolume_set(&device->volume, device->volume.channels,
+		       int_to_volume(n));
+
+	/* keep at most one request per device in flight; changes made in
+	   the meantime (a drag, a held key) go out together when it
+	   completes */
+	if (device->volume_in_flight) {
+		device->volume_pending = True;
+		STATS_VOLUME_CHANGED(device->volume_pending_at);
+		return;
+	}
 
-	device = get_current_device();
+	STATS_VOLUME_CHANGED(device->volume_changed_at);
+	device->volume_in_flight = send_device_volume(
+		device, TRACE_UPDATE_SLIDER, device);
+	if (!device->volume_in_flight)
+		device->volume_changed_at = 0;
+}
 
-	volume.channels = device->volume.channels;
-	channel_volume = int_to_volume(n);
-	for (i = 0; i < volume.channels; i++)
-		volume.values[i] = channel_volume;
-	device->volume = volume;
+PulseRequest *create_request(PulseServer *server, trace_op kind,
+			     void *target)
+{
+	PulseRequest *request;
+
+	request = wmalloc(sizeof(PulseRequest));
+	STATS_COUNT(STAT_ALLOCATIONS);
+	request->server = server;
+	request->kind = kind;
+	request->target = target;
+	request->sent_at = 0;
+	request->default_name = NULL;
+
+	return request;
+}
+
+/* keep the request until its reply; a replay has no operations, as the
+   trace supplies the replies */
+Bool track_request(PulseRequest *request, pa_operation *op)
+{
+	if (!op && !trace_replaying()) {
+		if (request->default_name)
+			wfree(request->default_name);
+		wfree(request);
+		return False;
+	}
+
+	if (op) {
+		STATS_OP_SENT(request->sent_at);
+		pa_operation_unref(op);
+		request_pulse_iteration();
+	}
+	WMAddToArray(request->server->requests, request);
+	return True;
+}
+
+void request_cb(pa_context *ctx, int success, void *userdata)
+{
+	PulseRequest *request = userdata;
+
+	(void)ctx;
+
+	STATS_OP_DONE(request->sent_at);
+	trace_op_done(request->server->number, request->kind, success);
+	WMRemoveFromArray(request->server->requests, request);
+	finish_request(request, success);
+}
+
+/* a request dropped with its server counts as failed */
+void finish_request(PulseRequest *request, Bool success)
+{
+	if (request->default_name) {
+		if (success)
+			set_default_name(request->server,
+					 request->default_type,
+					 request->default_name);
+		wfree(request->default_name);
+	}
+
+	switch (request->kind) {
+	case TRACE_UPDATE_SLIDER:
+		if (request->target)
+			volume_done(request->target);
+		break;
+
+	case TRACE_UPDATE_MUTED:
+		if (request->target)
+			update_muted(request->target);
+		break;
+
+	case TRACE_BATCH:
+		release_batch(request->target, success);
+		break;
+	}
+
+	wfree(request);
+}
+
+/* during a replay, each server's replies come back in the order its
+   requests were sent, so the reply is for the oldest */
+Bool replay_reply(PulseServer *server, int success)
+{
+	if (WMGetArrayItemCount(server->requests) == 0)
+		return False;
+
+	request_cb(NULL, success, WMGetFromArray(server->requests, 0));
+	return True;
+}
+
+/* false if the request couldn't be sent, in which case nothing is
+   updated when it completes */
+Bool send_device_volume(PulseDevice *device, trace_op kind, void *target)
+{
+	pa_context *ctx = device->server->ctx;
+	pa_operation *op;
+	PulseRequest *request;
+
+	if (device->server->lost)
+		return False;
+
+	request = create_request(device->server, kind, target);
+	if (trace_replaying())
+		return track_request(request, NULL);
 
 	switch (device->type) {
 	case PULSE_SINK:
-		pa_context_set_sink_volume_by_index(
-			ctx, device->index, &volume, update_slider_cb, NULL);
+		op = pa_context_set_sink_volume_by_index(
+			ctx, device->index, &device->volume, request_cb,
+			request);
 		break;
 
 	case PULSE_SOURCE:
-		pa_context_set_source_volume_by_index(
-			ctx, device->index, &volume, update_slider_cb, NULL);
+		op = pa_context_set_source_volume_by_index(
+			ctx, device->index, &device->volume, request_cb,
+			request);
 		break;
 
 	case PULSE_SINK_INPUT:
-		pa_context_set_sink_input_volume(
-			ctx, device->index, &volume, update_slider_cb, NULL);
+		op = pa_context_set_sink_input_volume(
+			ctx, device->index, &device->volume, request_cb,
+			request);
 		break;
 
 	case PULSE_SOURCE_OUTPUT:
-		pa_context_set_source_output_volume(
-			ctx, device->index, &volume, update_slider_cb, NULL);
+		op = pa_context_set_source_output_volume(
+			ctx, device->index, &device->volume, request_cb,
+			request);
 		break;
 
 	default:
 		wwarning("unknown device type");
+		op = NULL;
 		break;
 	}
 
+	return track_request(request, op);
 }
 
-void toggle_current_device_muted(WMWidget *widget, void *data)
+void toggle_device_muted(PulseDevice *device)
 {
-	PulseDevice *device;
-	Bool muted;
+	device->muted = !device->muted;
+	send_device_muted(device, TRACE_UPDATE_MUTED, device);
+}
 
-	(void)widget;
-	(void)data;
+Bool send_device_muted(PulseDevice *device, trace_op kind, void *target)
+{
+	pa_context *ctx = device->server->ctx;
+	pa_operation *op;
+	PulseRequest *request;
 
-	device = get_current_device();
-	muted = !device->muted;
-	device->muted = muted;
+	if (device->server->lost)
+		return False;
+
+	request = create_request(device->server, kind, target);
+	if (trace_replaying())
+		return track_request(request, NULL);
 
 	switch (device->type) {
 	case PULSE_SINK:
-		pa_context_set_sink_mute_by_index(
-			ctx, device->index, muted, update_muted_cb, NULL);
+		op = pa_context_set_sink_mute_by_index(
+			ctx, device->index, device->muted, request_cb,
+			request);
 		break;
 
 	case PULSE_SOURCE:
-		pa_context_set_source_mute_by_index(
-			ctx, device->index, muted, update_muted_cb, NULL);
+		op = pa_context_set_source_mute_by_index(
+			ctx, device->index, device->muted, request_cb,
+			request);
 		break;
 
 	case PULSE_SINK_INPUT:
-		pa_context_set_sink_input_mute(
-			ctx, device->index, muted, update_muted_cb, NULL);
+		op = pa_context_set_sink_input_mute(
+			ctx, device->index, device->muted, request_cb,
+			request);
 		break;
 
 	case PULSE_SOURCE_OUTPUT:
-		pa_context_set_source_output_mute(
-			ctx, device->index, muted, update_muted_cb, NULL);
+		op = pa_context_set_source_output_mute(
+			ctx, device->index, device->muted, request_cb,
+			request);
 		break;
 
 	default:
 		wwarning("unknown device type");
+		op = NULL;
 		break;
 	}
 
+	return track_request(request, op);
+}
 
+PulseBatch *create_batch(void (*done)(Bool ok, void *data), void *data)
+{
+	PulseBatch *batch;
+
+	batch = wmalloc(sizeof(PulseBatch));
+	STATS_COUNT(STAT_ALLOCATIONS);
+	/* held until finish_batch(), so replies arriving while the batch is
+	   still being filled can't complete it early */
+	batch->pending = 1;
+	batch->failed = False;
+	batch->done = done;
+	batch->data = data;
+
+	return batch;
 }
 
-void update_slider_cb(pa_context *ctx, int success, void *userdata)
+/* only requests that were actually sent are waited for, so a dead
+   connection can't keep the batch open */
+void batch_add_volume(PulseBatch *batch, PulseDevice *device)
 {
-	(void)ctx;
-	(void)success;
-	(void)userdata;
+	if (send_device_volume(device, TRACE_BATCH, batch))
+		batch->pending++;
+	else
+		batch->failed = True;
+}
 
-	update_slider();
+void batch_add_muted(PulseBatch *batch, PulseDevice *device)
+{
+	if (send_device_muted(device, TRACE_BATCH, batch))
+		batch->pending++;
+	else
+		batch->failed = True;
 }
 
-void update_muted_cb(pa_context *ctx, int success, void *userdata)
+/* only sinks and sources have defaults */
+void batch_add_default(PulseBatch *batch, PulseServer *server,
+		       pulse_type type, const char *name)
 {
-	(void)ctx;
-	(void)success;
-	(void)userdata;
+	pa_operation *op;
+	PulseRequest *request;
 
-	update_muted();
+	if (server->lost) {
+		batch->failed = True;
+		return;
+	}
+
+	request = create_request(server, TRACE_BATCH, batch);
+	request->default_type = type;
+	request->default_name = wstrdup(name);
+	STATS_COUNT(STAT_ALLOCATIONS);
+	if (trace_replaying())
+		op = NULL;
+	else if (type == PULSE_SINK)
+		op = pa_context_set_default_sink(server->ctx, name, request_cb,
+						 request);
+	else
+		op = pa_context_set_default_source(server->ctx, name,
+						   request_cb, request);
+
+	if (track_request(request, op))
+		batch->pending++;
+	else
+		batch->failed = True;
 }
 
-void increment_current_device(WMWidget *widget, void *data)
+void set_default_name(PulseServer *server, pulse_type type,
+		      const char *name)
 {
-	(void)widget;
-	(void)data;
+	if (type == PULSE_SINK) {
+		wfree(server->default_sink_name);
+		server->default_sink_name = wstrdup(name);
+	} else {
+		wfree(server->default_source_name);
+		server->default_source_name = wstrdup(name);
+	}
+	STATS_COUNT(STAT_ALLOCATIONS);
+}
 
-	current_device++;
+void finish_batch(PulseBatch *batch)
+{
+	release_batch(batch, True);
+}
 
-	if (current_device >= WMGetArrayItemCount(pulse_devices))
-		current_device = 0;
+void release_batch(PulseBatch *batch, Bool success)
+{
+	Bool ok;
+	void *data;
+	void (*done)(Bool ok, void *data);
 
-	update_device();
+	if (!success)
+		batch->failed = True;
+	if (--batch->pending > 0)
+		return;
+
+	ok = !batch->failed;
+	done = batch->done;
+	data = batch->data;
+	wfree(batch);
+	update_dockapps();
+	if (done)
+		done(ok, data);
 }
 
-void decrement_current_device(WMWidget *widget, void *data)
+unsigned int get_group(const char *name)
 {
-	(void)widget;
-	(void)data;
+	int i;
+
+	for (i = 0; pulse_groups[i].name; i++)
+		if (strcmp(pulse_groups[i].name, name) == 0)
+			return pulse_groups[i].mask;
+
+	wwarning("unknown device group '%s'", name);
+	return 0;
+}
+
+void mute_group(unsigned int group, Bool muted)
+{
+	int i;
+	PulseBatch *batch;
+	PulseDevice *device;
+
+	batch = create_batch(NULL, NULL);
+	for (i = 0; i < WMGetArrayItemCount(pulse_devices); i++) {
+		device = WMGetFromArray(pulse_devices, i);
+		if (!(group & PULSE_GROUP(device->type)) ||
+		    device->muted == muted)
+			continue;
+
+		device->muted = muted;
+		batch_add_muted(batch, device);
+	}
+	finish_batch(batch);
+}
+
+/* mute everything in the group if anything in it is audible, otherwise
+   unmute everything */
+void toggle_group_muted(unsigned int group)
+{
+	int i;
+	PulseDevice *device;
+	Bool muted;
+
+	muted = False;
+	for (i = 0; i < WMGetArrayItemCount(pulse_devices); i++) {
+		device = WMGetFromArray(pulse_devices, i);
+		if (group & PULSE_GROUP(device->type) && !device->muted) {
+			muted = True;
+			break;
+		}
+	}
+
+	mute_group(group, muted);
+}
 
-	current_device--;
+/* unmute the device and mute the others of the same type */
+void solo_device(PulseDevice *current)
+{
+	int i;
+	PulseBatch *batch;
+	PulseDevice *device;
+	Bool muted;
+
+	batch = create_batch(NULL, NULL);
+	for (i = 0; i < WMGetArrayItemCount(pulse_devices); i++) {
+		device = WMGetFromArray(pulse_devices, i);
+		if (device->type != current->type)
+			continue;
+
+		muted = device != current;
+		if (device->muted == muted)
+			continue;
+
+		device->muted = muted;
+		batch_add_muted(batch, device);
+	}
+	finish_batch(batch);
+}
 
-	if (current_device < 0)
-		current_device = WMGetArrayItemCount(pulse_devices) - 1;
+/* move the loudest device in the group k steps and scale the others by the
+   same factor, so their relative levels are kept */
+void change_group_volume_by(unsigned int group, int k)
+{
+	int i, j, n;
+	double factor;
+	PulseBatch *batch;
+	PulseDevice *device;
+	pa_volume_t loudest, channel_volume;
+	pa_cvolume volume;
+
+	loudest = PA_VOLUME_MUTED;
+	for (i = 0; i < WMGetArrayItemCount(pulse_devices); i++) {
+		device = WMGetFromArray(pulse_devices, i);
+		if (group & PULSE_GROUP(device->type) &&
+		    pa_cvolume_max(&device->volume) > loudest)
+			loudest = pa_cvolume_max(&device->volume);
+	}
+
+	n = volume_to_int(*pa_cvolume_set(&volume, 1, loudest)) + k;
+	if (n < 0)
+		n = 0;
+	else if (n > 25)
+		n = 25;
+
+	if (loudest == PA_VOLUME_MUTED)
+		factor = 0;
+	else
+		factor = (double)int_to_volume(n) / loudest;
+
+	batch = create_batch(NULL, NULL);
+	for (i = 0; i < WMGetArrayItemCount(pulse_devices); i++) {
+		device = WMGetFromArray(pulse_devices, i);
+		if (!(group & PULSE_GROUP(device->type)))
+			continue;
+
+		volume = device->volume;
+		for (j = 0; j < volume.channels; j++) {
+			/* nothing to scale from, so bring everything up to
+			   the new level together */
+			if (loudest == PA_VOLUME_MUTED)
+				channel_volume = int_to_volume(n);
+			else
+				channel_volume =
+					volume.values[j] * factor + 0.5;
+
+			if (channel_volume > 1.5 * PA_VOLUME_NORM)
+				channel_volume = 1.5 * PA_VOLUME_NORM;
+			volume.values[j] = channel_volume;
+		}
+
+		if (pa_cvolume_equal(&volume, &device->volume))
+			continue;
+
+		device->volume = volume;
+		batch_add_volume(batch, device);
+	}
+	finish_batch(batch);
+}
+
+/* send whatever changed while the last request was in flight */
+void volume_done(PulseDevice *device)
+{
+	/* a request dropped with its server was never acknowledged */
+	if (!device->server->lost)
+		STATS_VOLUME_ACKED(device->volume_changed_at);
+	device->volume_changed_at = 0;
+
+	if (device->volume_pending) {
+		device->volume_pending = False;
+		device->volume_in_flight = send_device_volume(
+			device, TRACE_UPDATE_SLIDER, device);
+		if (device->volume_in_flight)
+			device->volume_changed_at = device->volume_pending_at;
+		device->volume_pending_at = 0;
+	} else {
+		device->volume_in_flight = False;
+	}
 
-	update_device();
+	update_slider(device);
 }
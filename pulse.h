@@ -20,20 +20,107 @@
 #ifndef PULSE_H
 #define PULSE_H
 
+#include <pulse/context.h>
+#include <pulse/mainloop-api.h>
+#include <pulse/volume.h>
+#include <stdint.h>
 #include <WINGs/WINGs.h>
 #include <X11/Xlib.h>
 
-const char *get_current_device_description(void);
-WMPixmap *get_current_device_icon(void);
-int get_current_device_volume(void);
-Bool get_current_device_muted(void);
-void set_current_device_volume(int n);
-void toggle_current_device_muted(WMWidget *widget, void *data);
-void increment_current_device_volume(void);
-void decrement_current_device_volume(void);
-void increment_current_device(WMWidget *widget, void *data);
-void decrement_current_device(WMWidget *widget, void *data);
+typedef enum {
+	PULSE_SINK,
+	PULSE_SOURCE,
+	PULSE_SINK_INPUT,
+	PULSE_SOURCE_OUTPUT
+} pulse_type;
+
+/* one server; the devices of every server share a single list */
+typedef struct {
+	int number;
+	/* NULL for the default server */
+	char *address;
+	pa_context *ctx;
+	char *default_sink_name;
+	char *default_source_name;
+	/* the device list has come in, or the connection failed */
+	Bool loaded;
+	/* the connection is gone, and its devices with it, until it is
+	   made again */
+	Bool lost;
+	/* how long to wait before the next attempt to reconnect */
+	int retry_ms;
+	/* requests waiting for a reply, oldest first */
+	WMArray *requests;
+} PulseServer;
+
+/* only allocated when --monitor is given */
+typedef struct MonitorHistory MonitorHistory;
+
+typedef struct {
+	PulseServer *server;
+	pulse_type type;
+	uint32_t index;
+	const char *name;
+	const char *description;
+	char *icon_name;
+	/* looked up the first time the device is shown */
+	WMPixmap *icon;
+	pa_cvolume volume;
+	Bool muted;
+	/* a volume change is waiting for the server, and another one was
+	   made since it was sent */
+	Bool volume_in_flight;
+	Bool volume_pending;
+	/* when the first change covered by each of them was made, for the
+	   volume_ack_us statistic */
+	uint64_t volume_changed_at;
+	uint64_t volume_pending_at;
+	MonitorHistory *history;
+} PulseDevice;
+
+typedef struct PulseBatch PulseBatch;
+typedef struct PulseSelection PulseSelection;
+
+#define PULSE_GROUP(type) (1 << (type))
+
+PulseSelection *create_selection(const char *filter);
+PulseDevice *get_selected_device(PulseSelection *selection);
+void select_next_device(PulseSelection *selection);
+void select_previous_device(PulseSelection *selection);
+Bool select_device(PulseSelection *selection, int n);
+int volume_to_int(pa_cvolume volume);
+void set_device_volume(PulseDevice *device, int n);
+void change_device_volume_by(PulseDevice *device, int k);
+void toggle_device_muted(PulseDevice *device);
+void solo_device(PulseDevice *device);
+unsigned int get_group(const char *name);
+void mute_group(unsigned int group, Bool muted);
+void toggle_group_muted(unsigned int group);
+void change_group_volume_by(unsigned int group, int k);
+WMArray *get_devices(void);
+void add_pulse_server(const char *address);
+PulseServer *get_pulse_server(int n);
+int get_pulse_server_count(void);
+const char *get_server_name(PulseServer *server);
+const char *get_default_device_name(PulseServer *server, pulse_type type);
+PulseBatch *create_batch(void (*done)(Bool ok, void *data), void *data);
+void batch_add_volume(PulseBatch *batch, PulseDevice *device);
+void batch_add_muted(PulseBatch *batch, PulseDevice *device);
+void batch_add_default(PulseBatch *batch, PulseServer *server,
+		       pulse_type type, const char *name);
+void finish_batch(PulseBatch *batch);
+void add_device(PulseServer *server, pulse_type type, uint32_t index,
+		const char *name, const char *description,
+		const char *icon_name, pa_cvolume volume, Bool muted);
+PulseDevice *find_device(PulseServer *server, pulse_type type,
+			 uint32_t index);
+void forget_device(PulseServer *server, pulse_type type, uint32_t index);
+void devices_loaded(PulseServer *server);
+void server_lost(PulseServer *server);
+Bool replay_reply(PulseServer *server, int success);
 void setup_pulse(void);
-void iterate_pulse_mainloop(void *data);
+pa_mainloop_api *get_pulse_mainloop_api(void);
+void watch_pulse_mainloop(void);
+void run_pulse_mainloop(void);
 
 #endif
@@ -0,0 +1,288 @@
+/* wmpmixer - PulseAudio mixer as a Window Maker dockapp
+ * Copyright (C) 2021 Doug Torrance <dtorrance@piedmont.edu>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include "control.h"
+#include "dockapp.h"
+#include "hotkeys.h"
+#include "pulse.h"
+#include "replay.h"
+#include "stats.h"
+#include "trace.h"
+#include "wmpmixer.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <WINGs/WINGs.h>
+#include <WINGs/WUtil.h>
+#include <X11/Xlib.h>
+
+/* Feeds a trace loaded by setup_trace_replay() back through the dockapps,
+ * timing each kind of record. */
+
+WMArray *replay_records;
+int replay_position = 0;
+uint64_t replay_started, replay_due, replay_max_lag = 0;
+uint64_t replay_count[TRACE_RECORD_KINDS];
+uint64_t replay_time[TRACE_RECORD_KINDS];
+uint64_t replay_max[TRACE_RECORD_KINDS];
+
+const char *trace_record_names[TRACE_RECORD_KINDS] = {
+	"server",
+	"device",
+	"list_done",
+	"op_done",
+	"x_event",
+	"action",
+	"server_lost",
+	"hotkey",
+	"command",
+	"device_removed"
+};
+
+void replay_record(TraceRecord *record);
+void replay_all(void *data);
+void replay_next(void *data);
+void finish_replay(void);
+
+void replay_record(TraceRecord *record)
+{
+	uint64_t start, elapsed;
+	XEvent event;
+	Dockapp *dockapp;
+	PulseServer *server;
+	PulseSelection *selection;
+
+	start = monotonic_usec();
+
+	switch (record->kind) {
+	case TRACE_RECORD_SERVER:
+		add_pulse_server(record->u.server_address);
+		break;
+
+	case TRACE_RECORD_DEVICE:
+		server = get_pulse_server(record->u.device.server);
+		if (!server) {
+			wwarning("device from unknown server %d",
+				 record->u.device.server);
+			break;
+		}
+		add_device(server, record->u.device.type,
+			   record->u.device.index, record->u.device.name,
+			   record->u.device.description,
+			   record->u.device.icon_name,
+			   record->u.device.volume, record->u.device.muted);
+		break;
+
+	case TRACE_RECORD_DEVICE_REMOVED:
+		server = get_pulse_server(record->u.removed.server);
+		if (!server) {
+			wwarning("device removed from unknown server %d",
+				 record->u.removed.server);
+			break;
+		}
+		forget_device(server, record->u.removed.type,
+			      record->u.removed.index);
+		break;
+
+	case TRACE_RECORD_LIST_DONE:
+		server = get_pulse_server(record->u.server);
+		if (!server) {
+			wwarning("device list from unknown server %d",
+				 record->u.server);
+			break;
+		}
+		devices_loaded(server);
+		break;
+
+	case TRACE_RECORD_SERVER_LOST:
+		server = get_pulse_server(record->u.server);
+		if (!server) {
+			wwarning("lost unknown server %d", record->u.server);
+			break;
+		}
+		server_lost(server);
+		break;
+
+	case TRACE_RECORD_OP_DONE:
+		server = get_pulse_server(record->u.op.server);
+		if (!server || !replay_reply(server, record->u.op.success))
+			wwarning("reply with no operation in flight, "
+				 "replay is out of step with the trace");
+		break;
+
+	case TRACE_RECORD_X_EVENT:
+		dockapp = get_dockapp(record->u.x.dockapp);
+		if (!dockapp) {
+			wwarning("event for window %d, which replay did not "
+				 "open", record->u.x.dockapp + 1);
+			break;
+		}
+		memset(&event, 0, sizeof(event));
+		event.type = record->u.x.type;
+		event.xbutton.button = record->u.x.button;
+		event.xbutton.state = record->u.x.state;
+		event.xbutton.y = record->u.x.y;
+		slider_event(&event, dockapp);
+		break;
+
+	case TRACE_RECORD_ACTION:
+		dockapp = get_dockapp(record->u.action.dockapp);
+		if (!dockapp) {
+			wwarning("action for window %d, which replay did not "
+				 "open", record->u.action.dockapp + 1);
+			break;
+		}
+		switch (record->u.action.type) {
+		case TRACE_NEXT_DEVICE:
+			next_device_action(NULL, dockapp);
+			break;
+
+		case TRACE_PREVIOUS_DEVICE:
+			previous_device_action(NULL, dockapp);
+			break;
+
+		case TRACE_TOGGLE_MUTED:
+			mute_action(NULL, dockapp);
+			break;
+
+		default:
+			wwarning("unknown action in trace");
+			break;
+		}
+		break;
+
+	case TRACE_RECORD_HOTKEY:
+		selection = get_dockapp_selection(0);
+		if (!selection) {
+			wwarning("hotkey with no window open");
+			break;
+		}
+		hotkey_pressed(selection, record->u.hotkey.key,
+			       record->u.hotkey.shifted,
+			       record->u.hotkey.repeats);
+		break;
+
+	case TRACE_RECORD_COMMAND:
+		replay_command(record->u.command);
+		break;
+
+	default:
+		break;
+	}
+
+	elapsed = monotonic_usec() - start;
+	replay_count[record->kind]++;
+	replay_time[record->kind] += elapsed;
+	if (elapsed > replay_max[record->kind])
+		replay_max[record->kind] = elapsed;
+}
+
+void start_replay(void)
+{
+	replay_records = get_trace_records();
+	if (replay_realtime && WMGetArrayItemCount(replay_records) > 0)
+		WMAddTimerHandler(0, replay_next, NULL);
+	else
+		WMAddIdleHandler(replay_all, NULL);
+}
+
+/* one record per idle call, so paints, timers and the server get their
+   turn between records as they did in the recorded run */
+void replay_all(void *data)
+{
+	(void)data;
+
+	if (replay_position == 0)
+		replay_started = monotonic_usec();
+
+	if (replay_position < WMGetArrayItemCount(replay_records))
+		replay_record(WMGetFromArray(replay_records,
+					     replay_position++));
+
+	if (replay_position == WMGetArrayItemCount(replay_records))
+		finish_replay();
+	else
+		WMAddIdleHandler(replay_all, NULL);
+}
+
+void replay_next(void *data)
+{
+	uint64_t now;
+	TraceRecord *record;
+
+	(void)data;
+
+	now = monotonic_usec();
+	if (replay_position == 0) {
+		replay_started = now;
+		replay_due = now;
+	}
+
+	record = WMGetFromArray(replay_records, replay_position++);
+	if (now > replay_due && now - replay_due > replay_max_lag)
+		replay_max_lag = now - replay_due;
+	replay_record(record);
+
+	if (replay_position == WMGetArrayItemCount(replay_records)) {
+		finish_replay();
+		return;
+	}
+
+	record = WMGetFromArray(replay_records, replay_position);
+	replay_due += record->delta;
+	now = monotonic_usec();
+	WMAddTimerHandler(replay_due > now ? (replay_due - now) / 1000 : 0,
+			  replay_next, NULL);
+}
+
+void finish_replay(void)
+{
+	int i;
+	uint64_t elapsed;
+
+	/* include the last frame, and the time the X server takes to catch
+	   up with the redraws */
+	flush_paints();
+	XSync(WMScreenDisplay(get_screen()), False);
+	elapsed = monotonic_usec() - replay_started;
+
+	fprintf(stderr, "replayed %d records in %.3f ms (%s)\n",
+		WMGetArrayItemCount(replay_records), elapsed / 1000.0,
+		replay_realtime ? "real time" : "as fast as possible");
+	for (i = 0; i < TRACE_RECORD_KINDS; i++) {
+		if (!replay_count[i])
+			continue;
+
+		fprintf(stderr, "  %-10s %8llu  total %10.3f ms  "
+			"mean %8.1f us  max %8llu us\n",
+			trace_record_names[i],
+			(unsigned long long)replay_count[i],
+			replay_time[i] / 1000.0,
+			(double)replay_time[i] / replay_count[i],
+			(unsigned long long)replay_max[i]);
+	}
+	if (replay_realtime)
+		fprintf(stderr, "  max lag %llu us\n",
+			(unsigned long long)replay_max_lag);
+	dump_stats();
+
+	exit(EXIT_SUCCESS);
+}
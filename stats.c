@@ -0,0 +1,316 @@
+/* wmpmixer - PulseAudio mixer as a Window Maker dockapp
+ * Copyright (C) 2021 Doug Torrance <dtorrance@piedmont.edu>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include "monitor.h"
+#include "stats.h"
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <WINGs/WINGs.h>
+#include <WINGs/WUtil.h>
+
+/* microseconds on the monotonic clock, for everything that measures
+   time, stats or not */
+uint64_t monotonic_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#ifdef ENABLE_STATS
+
+/* power-of-two buckets of microseconds, the last one catching everything
+   from about 8 seconds up */
+#define STAT_BUCKETS 24
+
+typedef struct {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+	uint64_t buckets[STAT_BUCKETS];
+	uint64_t started;
+} StatHistogram;
+
+Bool stats_enabled = False;
+const char *stats_file;
+uint64_t stats_started;
+volatile sig_atomic_t stats_dump_requested = 0;
+
+uint64_t stat_counters[STAT_COUNTER_COUNT];
+StatHistogram stat_histograms[STAT_HISTOGRAM_COUNT];
+
+const char *stat_counter_names[STAT_COUNTER_COUNT] = {
+	"ops_sent",
+	"ops_done",
+	"icon_lookups",
+	"mainloop_iterations",
+	"allocations",
+	"paint_requests",
+	"paints"
+};
+
+const char *stat_histogram_names[STAT_HISTOGRAM_COUNT] = {
+	"op_latency_us",
+	"device_redraw_us",
+	"slider_redraw_us",
+	"icon_lookup_us",
+	"volume_ack_us"
+};
+
+void stats_record(stat_histogram h, uint64_t usec);
+void sigusr1_handler(int signum);
+
+void sigusr1_handler(int signum)
+{
+	(void)signum;
+
+	stats_dump_requested = 1;
+}
+
+void setup_stats(const char *file)
+{
+	struct sigaction action;
+
+	stats_enabled = True;
+	stats_file = file;
+	stats_started = monotonic_usec();
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = sigusr1_handler;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	if (sigaction(SIGUSR1, &action, NULL) < 0)
+		werror("unable to install SIGUSR1 handler");
+}
+
+Bool stats_available(void)
+{
+	return stats_enabled;
+}
+
+void stats_count(stat_counter c)
+{
+	stat_counters[c]++;
+}
+
+void stats_record(stat_histogram h, uint64_t usec)
+{
+	int bucket;
+	uint64_t n;
+	StatHistogram *histogram;
+
+	histogram = &stat_histograms[h];
+	histogram->count++;
+	histogram->sum += usec;
+	if (usec > histogram->max)
+		histogram->max = usec;
+
+	for (bucket = 0, n = usec; n > 1 && bucket < STAT_BUCKETS - 1;
+	     n >>= 1)
+		bucket++;
+	histogram->buckets[bucket]++;
+}
+
+void stats_begin(stat_histogram h)
+{
+	stat_histograms[h].started = monotonic_usec();
+}
+
+void stats_end(stat_histogram h)
+{
+	stats_record(h, monotonic_usec() - stat_histograms[h].started);
+}
+
+/* the send time, for the request to keep until its reply */
+uint64_t stats_op_sent(void)
+{
+	stat_counters[STAT_OPS_SENT]++;
+	return monotonic_usec();
+}
+
+/* a request sent before collection started, or one replayed from a
+   trace, is counted but not timed */
+void stats_op_done(uint64_t sent_at)
+{
+	stat_counters[STAT_OPS_DONE]++;
+
+	if (sent_at)
+		stats_record(STAT_OP_LATENCY, monotonic_usec() - sent_at);
+}
+
+/* a change made before collection started isn't timed */
+void stats_volume_acked(uint64_t changed_at)
+{
+	if (changed_at)
+		stats_record(STAT_VOLUME_ACK, monotonic_usec() - changed_at);
+}
+
+void poll_stats(void)
+{
+	if (!stats_dump_requested)
+		return;
+
+	stats_dump_requested = 0;
+	dump_stats();
+}
+
+void dump_stats(void)
+{
+	FILE *fp;
+
+	if (!stats_enabled)
+		return;
+
+	if (stats_file) {
+		fp = fopen(stats_file, "w");
+		if (!fp) {
+			wsyserror("unable to open %s", stats_file);
+			return;
+		}
+	} else {
+		fp = stderr;
+	}
+
+	write_stats(fp);
+
+	if (fp == stderr)
+		fflush(fp);
+	else
+		fclose(fp);
+}
+
+void write_stats(FILE *fp)
+{
+	int i, j;
+	double uptime;
+	StatHistogram *histogram;
+
+	fprintf(fp, "{\n  \"counters\": {");
+	for (i = 0; i < STAT_COUNTER_COUNT; i++)
+		fprintf(fp, "%s\n    \"%s\": %llu", i ? "," : "",
+			stat_counter_names[i],
+			(unsigned long long)stat_counters[i]);
+	/* each paint request used to be a paint of its own */
+	uptime = (monotonic_usec() - stats_started) / 1e6;
+	fprintf(fp, "\n  },\n  \"uptime_s\": %.3f,\n"
+		"  \"paints_saved_per_second\": %.1f,", uptime,
+		uptime > 0 ? (stat_counters[STAT_PAINT_REQUESTS] -
+			      stat_counters[STAT_PAINTS]) / uptime : 0);
+	fprintf(fp, "\n  \"histograms\": {");
+	for (i = 0; i < STAT_HISTOGRAM_COUNT; i++) {
+		histogram = &stat_histograms[i];
+		fprintf(fp, "%s\n    \"%s\": {\"count\": %llu, "
+			"\"sum\": %llu, \"max\": %llu, \"buckets\": [",
+			i ? "," : "", stat_histogram_names[i],
+			(unsigned long long)histogram->count,
+			(unsigned long long)histogram->sum,
+			(unsigned long long)histogram->max);
+		for (j = 0; j < STAT_BUCKETS; j++)
+			fprintf(fp, "%s%llu", j ? ", " : "",
+				(unsigned long long)histogram->buckets[j]);
+		fprintf(fp, "]}");
+	}
+	fprintf(fp, "\n  }");
+	dump_monitor(fp);
+	fprintf(fp, "\n}\n");
+}
+
+/* mean server round trip in milliseconds, short enough to fit over the
+   device icon */
+void format_stats_overlay(char *buf, size_t size)
+{
+	StatHistogram *histogram;
+
+	histogram = &stat_histograms[STAT_OP_LATENCY];
+	if (histogram->count == 0)
+		snprintf(buf, size, "-");
+	else
+		snprintf(buf, size, "%.1f",
+			 histogram->sum / (double)histogram->count / 1000);
+}
+
+#else
+
+void setup_stats(const char *file)
+{
+	(void)file;
+
+	wwarning("not built with --enable-stats, statistics are "
+		 "unavailable");
+}
+
+Bool stats_available(void)
+{
+	return False;
+}
+
+void stats_count(stat_counter c)
+{
+	(void)c;
+}
+
+void stats_begin(stat_histogram h)
+{
+	(void)h;
+}
+
+void stats_end(stat_histogram h)
+{
+	(void)h;
+}
+
+uint64_t stats_op_sent(void)
+{
+	return 0;
+}
+
+void stats_op_done(uint64_t sent_at)
+{
+	(void)sent_at;
+}
+
+void stats_volume_acked(uint64_t changed_at)
+{
+	(void)changed_at;
+}
+
+void poll_stats(void)
+{
+}
+
+void dump_stats(void)
+{
+}
+
+void write_stats(FILE *fp)
+{
+	(void)fp;
+}
+
+void format_stats_overlay(char *buf, size_t size)
+{
+	snprintf(buf, size, "-");
+}
+
+#endif
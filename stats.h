@@ -0,0 +1,96 @@
+/* wmpmixer - PulseAudio mixer as a Window Maker dockapp
+ * Copyright (C) 2021 Doug Torrance <dtorrance@piedmont.edu>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <WINGs/WINGs.h>
+
+typedef enum {
+	STAT_OPS_SENT,
+	STAT_OPS_DONE,
+	STAT_ICON_LOOKUPS,
+	STAT_MAINLOOP_ITERATIONS,
+	STAT_ALLOCATIONS,
+	STAT_PAINT_REQUESTS,
+	STAT_PAINTS,
+	STAT_COUNTER_COUNT
+} stat_counter;
+
+typedef enum {
+	STAT_OP_LATENCY,
+	STAT_DEVICE_REDRAW,
+	STAT_SLIDER_REDRAW,
+	STAT_ICON_LOOKUP,
+	STAT_VOLUME_ACK,
+	STAT_HISTOGRAM_COUNT
+} stat_histogram;
+
+/* The STATS_* macros compile to nothing unless configured with
+ * --enable-stats, and only cost a branch on stats_enabled otherwise. */
+#ifdef ENABLE_STATS
+extern Bool stats_enabled;
+
+#define STATS_COUNT(c) \
+	do { if (stats_enabled) stats_count(c); } while (0)
+#define STATS_BEGIN(h) \
+	do { if (stats_enabled) stats_begin(h); } while (0)
+#define STATS_END(h) \
+	do { if (stats_enabled) stats_end(h); } while (0)
+/* each request carries its own send time, as replies from different
+   servers can come back in any order */
+#define STATS_OP_SENT(sent_at) \
+	do { if (stats_enabled) (sent_at) = stats_op_sent(); } while (0)
+#define STATS_OP_DONE(sent_at) \
+	do { if (stats_enabled) stats_op_done(sent_at); } while (0)
+/* from the first change of a device's volume that the server hasn't
+   acknowledged yet to the reply that covers it */
+#define STATS_VOLUME_CHANGED(changed_at) \
+	do { if (stats_enabled && !(changed_at)) \
+		(changed_at) = monotonic_usec(); } while (0)
+#define STATS_VOLUME_ACKED(changed_at) \
+	do { if (stats_enabled) stats_volume_acked(changed_at); } while (0)
+#else
+#define STATS_COUNT(c) do { } while (0)
+#define STATS_BEGIN(h) do { } while (0)
+#define STATS_END(h) do { } while (0)
+#define STATS_OP_SENT(sent_at) do { } while (0)
+#define STATS_OP_DONE(sent_at) do { } while (0)
+#define STATS_VOLUME_CHANGED(changed_at) do { } while (0)
+#define STATS_VOLUME_ACKED(changed_at) do { } while (0)
+#endif
+
+uint64_t monotonic_usec(void);
+void setup_stats(const char *file);
+Bool stats_available(void);
+void stats_count(stat_counter c);
+void stats_begin(stat_histogram h);
+void stats_end(stat_histogram h);
+uint64_t stats_op_sent(void);
+void stats_op_done(uint64_t sent_at);
+void stats_volume_acked(uint64_t changed_at);
+void poll_stats(void);
+void dump_stats(void);
+void write_stats(FILE *fp);
+void format_stats_overlay(char *buf, size_t size);
+
+#endif
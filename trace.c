@@ -0,0 +1,476 @@
+/* wmpmixer - PulseAudio mixer as a Window Maker dockapp
+ * Copyright (C) 2021 Doug Torrance <dtorrance@piedmont.edu>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include "hotkeys.h"
+#include "pulse.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <pulse/context.h>
+#include <pulse/volume.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <WINGs/WINGs.h>
+#include <WINGs/WUtil.h>
+#include <X11/Xlib.h>
+
+/* A trace is the magic and version, followed by records.  Each record is
+ * a kind byte, the time in microseconds since the previous record, and a
+ * kind-specific payload.  Integers are little-endian; strings are a 16-bit
+ * length (0xffff for NULL) followed by the bytes. */
+#define TRACE_MAGIC "WMPT"
+#define TRACE_VERSION 8
+#define TRACE_NULL_STRING 0xffff
+
+
+FILE *trace_fp = NULL;
+Bool trace_dirty = False;
+uint64_t trace_last;
+
+Bool replaying = False;
+WMArray *trace_records;
+
+
+void write_record_header(trace_record_kind kind);
+void write_u8(uint8_t n);
+void write_u16(uint16_t n);
+void write_u32(uint32_t n);
+void write_string(const char *str);
+Bool read_u8(FILE *fp, uint8_t *n);
+Bool read_u16(FILE *fp, uint16_t *n);
+Bool read_u32(FILE *fp, uint32_t *n);
+Bool read_string(FILE *fp, char **str);
+TraceRecord *read_record(FILE *fp);
+
+void setup_trace_recording(const char *file)
+{
+	trace_fp = fopen(file, "wb");
+	if (!trace_fp) {
+		wsyserror("unable to open %s", file);
+		exit(EXIT_FAILURE);
+	}
+
+	fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), trace_fp);
+	write_u32(TRACE_VERSION);
+	trace_last = monotonic_usec();
+}
+
+void write_u8(uint8_t n)
+{
+	fputc(n, trace_fp);
+}
+
+void write_u16(uint16_t n)
+{
+	write_u8(n & 0xff);
+	write_u8(n >> 8);
+}
+
+void write_u32(uint32_t n)
+{
+	write_u16(n & 0xffff);
+	write_u16(n >> 16);
+}
+
+void write_string(const char *str)
+{
+	size_t len;
+
+	if (!str) {
+		write_u16(TRACE_NULL_STRING);
+		return;
+	}
+
+	len = strlen(str);
+	if (len >= TRACE_NULL_STRING)
+		len = TRACE_NULL_STRING - 1;
+	write_u16(len);
+	fwrite(str, 1, len, trace_fp);
+}
+
+void write_record_header(trace_record_kind kind)
+{
+	uint64_t now, delta;
+
+	now = monotonic_usec();
+	delta = now - trace_last;
+	trace_last = now;
+
+	write_u8(kind);
+	write_u32(delta > UINT32_MAX ? UINT32_MAX : delta);
+	trace_dirty = True;
+}
+
+void trace_server(const char *address)
+{
+	if (!trace_fp)
+		return;
+
+	write_record_header(TRACE_RECORD_SERVER);
+	write_string(address);
+}
+
+void trace_device(int server, pulse_type type, uint32_t index,
+		  const char *name, const char *description,
+		  const char *icon_name, const pa_cvolume *volume, Bool muted)
+{
+	int i;
+
+	if (!trace_fp)
+		return;
+
+	write_record_header(TRACE_RECORD_DEVICE);
+	write_u8(server);
+	write_u8(type);
+	write_u32(index);
+	write_string(name);
+	write_string(description);
+	write_string(icon_name);
+	write_u8(muted);
+	write_u8(volume->channels);
+	for (i = 0; i < volume->channels; i++)
+		write_u32(volume->values[i]);
+}
+
+void trace_device_removed(int server, pulse_type type, uint32_t index)
+{
+	if (!trace_fp)
+		return;
+
+	write_record_header(TRACE_RECORD_DEVICE_REMOVED);
+	write_u8(server);
+	write_u8(type);
+	write_u32(index);
+}
+
+void trace_list_done(int server)
+{
+	if (!trace_fp)
+		return;
+
+	write_record_header(TRACE_RECORD_LIST_DONE);
+	write_u8(server);
+}
+
+void trace_server_lost(int server)
+{
+	if (!trace_fp)
+		return;
+
+	write_record_header(TRACE_RECORD_SERVER_LOST);
+	write_u8(server);
+}
+
+void trace_op_done(int server, trace_op op, int success)
+{
+	if (!trace_fp)
+		return;
+
+	write_record_header(TRACE_RECORD_OP_DONE);
+	write_u8(server);
+	write_u8(op);
+	write_u8(success != 0);
+}
+
+void trace_x_event(int dockapp, XEvent *event)
+{
+	if (!trace_fp)
+		return;
+
+	/* the button and motion events handled by slider_event() share
+	   this layout */
+	write_record_header(TRACE_RECORD_X_EVENT);
+	write_u8(dockapp);
+	write_u8(event->type);
+	write_u8(event->xbutton.button);
+	write_u16(event->xbutton.state);
+	write_u16(event->xbutton.y);
+}
+
+void trace_action(int dockapp, trace_action_type action)
+{
+	if (!trace_fp)
+		return;
+
+	write_record_header(TRACE_RECORD_ACTION);
+	write_u8(dockapp);
+	write_u8(action);
+}
+
+/* hotkeys act on the first window's selection, so only the key matters;
+   the repeat count decides the step, which depends on timing */
+void trace_hotkey(hotkey key, Bool shifted, int repeats)
+{
+	if (!trace_fp)
+		return;
+
+	write_record_header(TRACE_RECORD_HOTKEY);
+	write_u8(key);
+	write_u8(shifted != 0);
+	write_u16(repeats > 0xffff ? 0xffff : repeats);
+}
+
+void trace_command(const char *line)
+{
+	if (!trace_fp)
+		return;
+
+	write_record_header(TRACE_RECORD_COMMAND);
+	write_string(line);
+}
+
+/* called from the main loop timer, so a killed dockapp loses at most the
+   last tick of its trace */
+void poll_trace(void)
+{
+	if (!trace_dirty)
+		return;
+
+	fflush(trace_fp);
+	trace_dirty = False;
+}
+
+Bool read_u8(FILE *fp, uint8_t *n)
+{
+	int c;
+
+	c = fgetc(fp);
+	if (c == EOF)
+		return False;
+
+	*n = c;
+	return True;
+}
+
+Bool read_u16(FILE *fp, uint16_t *n)
+{
+	uint8_t lo, hi;
+
+	if (!read_u8(fp, &lo) || !read_u8(fp, &hi))
+		return False;
+
+	*n = lo | hi << 8;
+	return True;
+}
+
+Bool read_u32(FILE *fp, uint32_t *n)
+{
+	uint16_t lo, hi;
+
+	if (!read_u16(fp, &lo) || !read_u16(fp, &hi))
+		return False;
+
+	*n = lo | (uint32_t)hi << 16;
+	return True;
+}
+
+Bool read_string(FILE *fp, char **str)
+{
+	uint16_t len;
+
+	if (!read_u16(fp, &len))
+		return False;
+
+	if (len == TRACE_NULL_STRING) {
+		*str = NULL;
+		return True;
+	}
+
+	*str = wmalloc(len + 1);
+	if (fread(*str, 1, len, fp) != len) {
+		wfree(*str);
+		return False;
+	}
+	(*str)[len] = '\0';
+
+	return True;
+}
+
+TraceRecord *read_record(FILE *fp)
+{
+	int i;
+	uint8_t u8;
+	uint16_t u16;
+	uint32_t u32;
+	TraceRecord *record;
+
+	if (!read_u8(fp, &u8))
+		return NULL;
+
+	record = wmalloc(sizeof(TraceRecord));
+	record->kind = u8;
+	if (!read_u32(fp, &record->delta))
+		goto error;
+
+	switch (record->kind) {
+	case TRACE_RECORD_SERVER:
+		if (!read_string(fp, &record->u.server_address))
+			goto error;
+		break;
+
+	case TRACE_RECORD_COMMAND:
+		if (!read_string(fp, &record->u.command) || !record->u.command)
+			goto error;
+		break;
+
+	case TRACE_RECORD_DEVICE:
+		if (!read_u8(fp, &u8))
+			goto error;
+		record->u.device.server = u8;
+		if (!read_u8(fp, &u8))
+			goto error;
+		record->u.device.type = u8;
+		if (!read_u32(fp, &record->u.device.index) ||
+		    !read_string(fp, &record->u.device.name) ||
+		    !read_string(fp, &record->u.device.description) ||
+		    !read_string(fp, &record->u.device.icon_name) ||
+		    !read_u8(fp, &u8))
+			goto error;
+		record->u.device.muted = u8;
+		if (!read_u8(fp, &u8) || u8 > PA_CHANNELS_MAX)
+			goto error;
+		record->u.device.volume.channels = u8;
+		for (i = 0; i < u8; i++) {
+			if (!read_u32(fp, &u32))
+				goto error;
+			record->u.device.volume.values[i] = u32;
+		}
+		break;
+
+	case TRACE_RECORD_DEVICE_REMOVED:
+		if (!read_u8(fp, &u8))
+			goto error;
+		record->u.removed.server = u8;
+		if (!read_u8(fp, &u8))
+			goto error;
+		record->u.removed.type = u8;
+		if (!read_u32(fp, &record->u.removed.index))
+			goto error;
+		break;
+
+	case TRACE_RECORD_LIST_DONE:
+	case TRACE_RECORD_SERVER_LOST:
+		if (!read_u8(fp, &u8))
+			goto error;
+		record->u.server = u8;
+		break;
+
+	case TRACE_RECORD_OP_DONE:
+		if (!read_u8(fp, &u8))
+			goto error;
+		record->u.op.server = u8;
+		if (!read_u8(fp, &u8))
+			goto error;
+		record->u.op.op = u8;
+		if (!read_u8(fp, &u8))
+			goto error;
+		record->u.op.success = u8;
+		break;
+
+	case TRACE_RECORD_X_EVENT:
+		if (!read_u8(fp, &u8))
+			goto error;
+		record->u.x.dockapp = u8;
+		if (!read_u8(fp, &u8))
+			goto error;
+		record->u.x.type = u8;
+		if (!read_u8(fp, &u8))
+			goto error;
+		record->u.x.button = u8;
+		if (!read_u16(fp, &u16))
+			goto error;
+		record->u.x.state = u16;
+		if (!read_u16(fp, &u16))
+			goto error;
+		record->u.x.y = (int16_t)u16;
+		break;
+
+	case TRACE_RECORD_ACTION:
+		if (!read_u8(fp, &u8))
+			goto error;
+		record->u.action.dockapp = u8;
+		if (!read_u8(fp, &u8))
+			goto error;
+		record->u.action.type = u8;
+		break;
+
+	case TRACE_RECORD_HOTKEY:
+		if (!read_u8(fp, &u8))
+			goto error;
+		record->u.hotkey.key = u8;
+		if (!read_u8(fp, &u8))
+			goto error;
+		record->u.hotkey.shifted = u8;
+		if (!read_u16(fp, &u16))
+			goto error;
+		record->u.hotkey.repeats = u16;
+		break;
+
+	default:
+		goto error;
+	}
+
+	return record;
+
+error:
+	werror("truncated or corrupt trace record");
+	exit(EXIT_FAILURE);
+}
+
+void setup_trace_replay(const char *file)
+{
+	char magic[4];
+	uint32_t version;
+	FILE *fp;
+	TraceRecord *record;
+
+	fp = fopen(file, "rb");
+	if (!fp) {
+		wsyserror("unable to open %s", file);
+		exit(EXIT_FAILURE);
+	}
+
+	if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) ||
+	    memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 ||
+	    !read_u32(fp, &version) || version != TRACE_VERSION) {
+		werror("%s is not a wmpmixer trace", file);
+		exit(EXIT_FAILURE);
+	}
+
+	/* load everything up front so file I/O doesn't show up in the
+	   timings */
+	trace_records = WMCreateArray(0);
+	while ((record = read_record(fp)))
+		WMAddToArray(trace_records, record);
+	fclose(fp);
+
+	replaying = True;
+}
+
+Bool trace_replaying(void)
+{
+	return replaying;
+}
+
+WMArray *get_trace_records(void)
+{
+	return trace_records;
+}
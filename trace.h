@@ -0,0 +1,122 @@
+/* wmpmixer - PulseAudio mixer as a Window Maker dockapp
+ * Copyright (C) 2021 Doug Torrance <dtorrance@piedmont.edu>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <pulse/volume.h>
+#include <stdint.h>
+#include <WINGs/WINGs.h>
+#include <X11/Xlib.h>
+
+#include "hotkeys.h"
+#include "pulse.h"
+
+/* which callback an operation reply went to */
+typedef enum {
+	TRACE_UPDATE_SLIDER,
+	TRACE_UPDATE_MUTED,
+	TRACE_BATCH
+} trace_op;
+
+typedef enum {
+	TRACE_NEXT_DEVICE,
+	TRACE_PREVIOUS_DEVICE,
+	TRACE_TOGGLE_MUTED
+} trace_action_type;
+
+typedef enum {
+	TRACE_RECORD_SERVER,
+	TRACE_RECORD_DEVICE,
+	TRACE_RECORD_LIST_DONE,
+	TRACE_RECORD_OP_DONE,
+	TRACE_RECORD_X_EVENT,
+	TRACE_RECORD_ACTION,
+	TRACE_RECORD_SERVER_LOST,
+	TRACE_RECORD_HOTKEY,
+	TRACE_RECORD_COMMAND,
+	TRACE_RECORD_DEVICE_REMOVED,
+	TRACE_RECORD_KINDS
+} trace_record_kind;
+
+typedef struct {
+	trace_record_kind kind;
+	uint32_t delta;
+	union {
+		char *server_address;
+		char *command;
+		int server;
+		struct {
+			int server;
+			pulse_type type;
+			uint32_t index;
+			char *name;
+			char *description;
+			char *icon_name;
+			pa_cvolume volume;
+			Bool muted;
+		} device;
+		struct {
+			int server;
+			pulse_type type;
+			uint32_t index;
+		} removed;
+		struct {
+			int server;
+			trace_op op;
+			int success;
+		} op;
+		struct {
+			int dockapp;
+			int type;
+			unsigned int button;
+			unsigned int state;
+			int y;
+		} x;
+		struct {
+			int dockapp;
+			trace_action_type type;
+		} action;
+		struct {
+			hotkey key;
+			Bool shifted;
+			int repeats;
+		} hotkey;
+	} u;
+} TraceRecord;
+
+void setup_trace_recording(const char *file);
+void setup_trace_replay(const char *file);
+Bool trace_replaying(void);
+WMArray *get_trace_records(void);
+void trace_server(const char *address);
+void trace_device(int server, pulse_type type, uint32_t index,
+		  const char *name, const char *description,
+		  const char *icon_name, const pa_cvolume *volume, Bool muted);
+void trace_device_removed(int server, pulse_type type, uint32_t index);
+void trace_list_done(int server);
+void trace_server_lost(int server);
+void trace_op_done(int server, trace_op op, int success);
+void trace_x_event(int dockapp, XEvent *event);
+void trace_action(int dockapp, trace_action_type action);
+void trace_hotkey(hotkey key, Bool shifted, int repeats);
+void trace_command(const char *line);
+void poll_trace(void);
+
+#endif
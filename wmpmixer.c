@@ -17,327 +17,324 @@
  * USA.
  */
 
-#include <gtk/gtk.h>
+#include <dlfcn.h>
+#include <getopt.h>
+#include <stdio.h>
 #include <stdlib.h>
-#include <WINGs/WINGs.h>
 #include <WINGs/WUtil.h>
-#include <wraster.h>
-#include <X11/extensions/shape.h>
-#include <X11/extensions/shapeconst.h>
-#include <X11/X.h>
-#include <X11/Xlib.h>
-#include <X11/Xutil.h>
 
+#include "control.h"
+#include "hotkeys.h"
+#include "monitor.h"
+#include "profile.h"
 #include "pulse.h"
+#include "stats.h"
+#include "trace.h"
 #include "wmpmixer.h"
 
-#define MARGIN 4
-#define PADDING 5
-#define DOCKAPP_MEASURE 64
-#define ICON_MEASURE 22
-#define BUTTON_Y MARGIN + ICON_MEASURE + 2 + PADDING
-#define BUTTON_MEASURE 13
-#define SLIDER_WIDTH 25
-#define SLIDER_HEIGHT ICON_MEASURE + 2 + PADDING + 2 * BUTTON_MEASURE
-#define SLIDER_X MARGIN + 2 * BUTTON_MEASURE + PADDING
-
-WMScreen *screen;
-WMLabel *icon_label, *slider_label;
-WMButton *mute_button;
-RColor slider_color[25];
-
-static char * left_xpm[] = {
-	"4 7 2 1",
-	" 	c #AEAAAE",
-	".	c #000000",
-	"   .",
-	"  ..",
-	" ...",
-	"....",
-	" ...",
-	"  ..",
-	"   ."};
-
-static char * right_xpm[] = {
-	"4 7 2 1",
-	" 	c #000000",
-	".	c #AEAAAE",
-	" ...",
-	"  ..",
-	"   .",
-	"    ",
-	"   .",
-	"  ..",
-	" ..."};
-
-static char * record_xpm[] = {
-	"6 5 4 1",
-	" 	c #AEAAAE",
-	".	c #FA0808",
-	"+	c #FF0000",
-	"@	c #FE0000",
-	" .++@ ",
-	"..@.+@",
-	".@@@.@",
-	".@@@+@",
-	" .@+@ "};
-
-static char * mute_xpm[] = {
-	"10 9 3 1",
-	" 	c #FF0000",
-	".	c #AEAAAE",
-	"+	c #000000",
-	" ........ ",
-	". ....++ .",
-	".. ..+.+..",
-	"..+++. +..",
-	"..+.  .+..",
-	"..+++. +..",
-	".. ..+.+..",
-	". ....++ .",
-	" ........ "};
-
-void create_slider_colors(void);
-void slider_event(XEvent *event, void *data);
-void setup_window(WMWindow *window);
-int y_to_bar(int y);
+/* overrides where the dockapp module is loaded from, e.g. to run from the
+   build directory */
+#define DOCKAPP_MODULE_ENV "WMPMIXER_DOCKAPP"
+
+WMArray *window_filters;
+WMArray *server_addresses;
+Bool stats_overlay = False;
+Bool monitor = False;
+char *replay_file = NULL;
+Bool replay_realtime = False;
+Bool use_hotkeys = False;
+const char *hotkey_keysyms[HOTKEY_COUNT];
+Bool headless = False;
+Bool use_control = False;
+char *control_path = NULL;
+int max_fps = 60;
+/* the windows, NULL until they are needed */
+DockappModule *loaded_module = NULL;
+
+void parse_options(int argc, char **argv);
+void run_headless(void);
+void load_dockapp_module(void);
+void print_help(const char *prog);
 
 int main(int argc, char **argv)
 {
-	Display *display;
-	WMWindow *window;
-
-	WMInitializeApplication(PACKAGE_NAME, &argc, argv);
+	parse_options(argc, argv);
+	/* a profile run exits as soon as the server has answered, so it
+	   never needs a window */
+	if (has_profile_action())
+		headless = True;
+	if (headless) {
+		run_headless();
+		return 0;
+	}
 
-	/* for looking up icons */
-	gtk_init(&argc, &argv);
+	load_dockapp_module();
+	return loaded_module->run(argc, argv);
+}
 
-	display = XOpenDisplay("");
-	if (!display) {
-		werror("could not connect to X server");
+/* just the PulseAudio client and the control socket: the dockapp module,
+   and X, WINGs and GTK with it, is never loaded */
+void run_headless(void)
+{
+	if (replay_file) {
+		werror("replaying a trace needs an X display");
 		exit(EXIT_FAILURE);
 	}
 
-	screen = WMCreateScreen(display, DefaultScreen(display));
-	window = WMCreateWindow(screen, PACKAGE_NAME);
-	create_slider_colors();
-	setup_window(window);
+	add_servers();
 	setup_pulse();
-
-	WMAddPersistentTimerHandler(100, iterate_pulse_mainloop, NULL);
-	WMScreenMainLoop(screen);
-
-	return 0;
+	if (!has_profile_action()) {
+		if (monitor)
+			setup_monitor();
+		setup_control(control_path ? control_path :
+			      get_default_control_path());
+	}
+	run_pulse_mainloop();
 }
 
-void setup_window(WMWindow *window) {
-	Display *display;
-	Window xid;
-	XRectangle rect[3];
-	XWMHints *hints;
-	WMColor *bg;
-	WMFrame *icon_frame, *slider_frame;
-	WMButton *left_button, *right_button, *record_button;
-	WMPixmap *left_pix, *right_pix, *record_pix, *mute_pix;
-
-	WMRealizeWidget(window);
-	WMResizeWidget(window, DOCKAPP_MEASURE, DOCKAPP_MEASURE);
-
-	xid = WMWidgetXID(window);
-	screen = WMWidgetScreen(window);
-	display = WMScreenDisplay(screen);
-
-	hints = XGetWMHints(display, xid);
-	hints->flags |= WindowGroupHint;
-	hints->window_group = xid;
-
-	/* TODO - allow windowed mode */
-	hints->flags |= IconWindowHint | StateHint;
-	hints->icon_window = xid;
-	hints->initial_state = WithdrawnState;
-
-	XSetWMHints(display, xid, hints);
-	XFree(hints);
-
-	/* icons */
-	rect[0].x = MARGIN;
-	rect[0].y = MARGIN;
-	rect[0].width = 2 * BUTTON_MEASURE;
-	rect[0].height = ICON_MEASURE + 2;
-
-	/* buttons */
-	rect[1].x = MARGIN;
-	rect[1].y = BUTTON_Y;
-	rect[1].width = 2 * BUTTON_MEASURE;
-	rect[1].height = 2 * BUTTON_MEASURE;
-
-	/* volume slider */
-	rect[2].x = SLIDER_X;
-	rect[2].y = MARGIN;
-	rect[2].width = SLIDER_WIDTH;
-	rect[2].height = SLIDER_HEIGHT;
-
-	XShapeCombineRectangles(display, xid, ShapeBounding, 0, 0, rect, 3,
-				ShapeSet, Unsorted);
-
-	bg = WMCreateRGBColor(screen, 0x2800, 0x2800, 0x2800, False);
-
-	icon_frame = WMCreateFrame(window);
-	WMSetFrameRelief(icon_frame, WRPushed);
-	WMResizeWidget(icon_frame, 2 * BUTTON_MEASURE, ICON_MEASURE + 2);
-	WMMoveWidget(icon_frame, MARGIN, MARGIN);
-	WMRealizeWidget(icon_frame);
-
-	icon_label = WMCreateLabel(icon_frame);
-	WMResizeWidget(icon_label, ICON_MEASURE + 2, ICON_MEASURE);
-	WMMoveWidget(icon_label, 1, 1);
-	WMSetWidgetBackgroundColor(icon_label, bg);
-	WMSetLabelImagePosition(icon_label, WIPImageOnly);
-	WMRealizeWidget(icon_label);
-
-	slider_frame = WMCreateFrame(window);
-	WMSetFrameRelief(slider_frame, WRPushed);
-	WMResizeWidget(slider_frame, SLIDER_WIDTH, SLIDER_HEIGHT);
-	WMMoveWidget(slider_frame, SLIDER_X, MARGIN);
-	WMSetWidgetBackgroundColor(slider_frame, bg);
-	WMRealizeWidget(slider_frame);
-
-	slider_label = WMCreateLabel(slider_frame);
-	WMResizeWidget(slider_label, SLIDER_WIDTH - 2, SLIDER_HEIGHT - 2);
-	WMMoveWidget(slider_label, 1, 1);
-	WMSetWidgetBackgroundColor(slider_label, bg);
-	WMSetLabelImagePosition(slider_label, WIPImageOnly);
-	WMCreateEventHandler(
-		WMWidgetView(slider_label),
-		ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
-		slider_event, NULL);
-	WMRealizeWidget(slider_label);
-
-	left_button = WMCreateButton(window, WBTMomentaryPush);
-	WMResizeWidget(left_button, BUTTON_MEASURE, BUTTON_MEASURE);
-	WMMoveWidget(left_button, MARGIN, BUTTON_Y);
-	left_pix = WMCreatePixmapFromXPMData(screen, left_xpm);
-	WMSetButtonImage(left_button, left_pix);
-	WMSetButtonImagePosition(left_button, WIPImageOnly);
-	WMSetButtonAction(left_button, decrement_current_device, NULL);
-	WMRealizeWidget(left_button);
-
-	right_button = WMCreateButton(window, WBTMomentaryPush);
-	WMResizeWidget(right_button, BUTTON_MEASURE, BUTTON_MEASURE);
-	WMMoveWidget(right_button, MARGIN + BUTTON_MEASURE, BUTTON_Y);
-	right_pix = WMCreatePixmapFromXPMData(screen, right_xpm);
-	WMSetButtonImage(right_button, right_pix);
-	WMSetButtonImagePosition(right_button, WIPImageOnly);
-	WMSetButtonAction(right_button, increment_current_device, NULL);
-	WMRealizeWidget(right_button);
-
-	record_button = WMCreateButton(window, WBTToggle);
-	WMResizeWidget(record_button, BUTTON_MEASURE, BUTTON_MEASURE);
-	WMMoveWidget(record_button, MARGIN, BUTTON_Y + BUTTON_MEASURE);
-	record_pix = WMCreatePixmapFromXPMData(screen, record_xpm);
-	WMSetButtonImage(record_button, record_pix);
-	WMSetButtonImagePosition(record_button, WIPImageOnly);
-	/* TODO - implement recording */
-	WMSetButtonEnabled(record_button, False);
-	WMRealizeWidget(record_button);
-
-	mute_button = WMCreateButton(window, WBTToggle);
-	WMResizeWidget(mute_button, BUTTON_MEASURE, BUTTON_MEASURE);
-	WMMoveWidget(mute_button, MARGIN + BUTTON_MEASURE,
-		     BUTTON_Y + BUTTON_MEASURE);
-	mute_pix = WMCreatePixmapFromXPMData(screen, mute_xpm);
-	WMSetButtonImage(mute_button, mute_pix);
-	WMSetButtonImagePosition(mute_button, WIPImageOnly);
-	WMSetButtonAction(mute_button, toggle_current_device_muted, NULL);
-	WMRealizeWidget(mute_button);
-
-	WMMapWidget(window);
-	WMMapSubwidgets(window);
-	WMMapWidget(icon_label);
-	WMMapWidget(slider_label);
-}
+/* after parse_options(), so a trace being recorded sees them */
+void add_servers(void)
+{
+	int i;
 
-WMScreen *get_screen(void) {
-	return screen;
+	for (i = 0; i < WMGetArrayItemCount(server_addresses); i++)
+		add_pulse_server(WMGetFromArray(server_addresses, i));
 }
 
-void create_slider_colors(void)
+/* X, WINGs and GTK are only linked into the module, so a headless run
+   never loads them */
+void load_dockapp_module(void)
 {
-	int i;
+	const char *path;
+	void *handle;
 
-	/* based on XHandler::mixColor() from wmmixer */
-	for (i = 0; i < 25; i++) {
-		slider_color[i].red = 255 * i / (50 - i);
-		slider_color[i].green = 255 * (50 - 2 * i) / (50 - i);
-		slider_color[i].blue = 0;
-		slider_color[i].alpha = 255;
+	path = getenv(DOCKAPP_MODULE_ENV);
+	if (!path || !*path)
+		path = PKGLIBDIR "/dockapp.so";
+
+	handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (!handle) {
+		werror("unable to load %s", dlerror());
+		exit(EXIT_FAILURE);
+	}
+
+	loaded_module = dlsym(handle, "dockapp_module");
+	if (!loaded_module) {
+		werror("%s is not a %s dockapp module", path, PACKAGE_NAME);
+		exit(EXIT_FAILURE);
 	}
 }
 
-void update_device(void)
+/* model changes reach the windows, if there are any */
+void update_dockapps(void)
 {
-	WMSetBalloonTextForView(get_current_device_description(),
-				WMWidgetView(icon_label));
-	WMSetLabelImage(icon_label, get_current_device_icon());
-	WMRedisplayWidget(icon_label);
-
-	update_muted();
-	update_slider();
+	if (loaded_module)
+		loaded_module->update_dockapps();
 }
 
-void update_muted(void)
+void update_slider(PulseDevice *device)
 {
-	WMSetButtonSelected(mute_button, get_current_device_muted());
-	WMRedisplayWidget(mute_button);
+	if (loaded_module)
+		loaded_module->update_slider(device);
 }
 
-void update_slider(void)
+void update_muted(PulseDevice *device)
 {
-	int i;
-	RImage *image;
-	WMPixmap *slider_pix;
-
-	RColor bg = {40, 40, 40, 255};
-
-
-	image = RCreateImage(SLIDER_WIDTH - 2, SLIDER_HEIGHT - 2, False);
-	RFillImage(image, &bg);
-
-	for (i = 0; i < get_current_device_volume(); i++)
-		RDrawLine(image, 1, SLIDER_HEIGHT - 5 - 2 * i,
-			  SLIDER_WIDTH - 5, SLIDER_HEIGHT - 5 - 2 * i,
-			  &slider_color[i]);
-
-	slider_pix = WMCreatePixmapFromRImage(screen, image, 127);
-	WMSetLabelImage(slider_label, slider_pix);
-	WMRedisplayWidget(slider_label);
-
-	RReleaseImage(image);
+	if (loaded_module)
+		loaded_module->update_muted(device);
 }
 
-void slider_event(XEvent *event, void *data)
+void parse_options(int argc, char **argv)
 {
-	(void)data;
-
-	if (((event->type == ButtonPress || event->type == ButtonRelease)
-	     && event->xbutton.button == Button1) ||
-	    (event->type == MotionNotify && event->xmotion.state & Button1Mask))
-		set_current_device_volume(y_to_bar(event->xbutton.y));
-	else if (event->type == ButtonPress && event->xbutton.button == Button4)
-		increment_current_device_volume();
-	else if (event->type == ButtonPress && event->xbutton.button == Button5)
-		decrement_current_device_volume();
+	int opt;
+	const char *save = NULL, *load = NULL;
+	struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"version", no_argument, NULL, 'v'},
+		{"stats", optional_argument, NULL, 's'},
+		{"stats-overlay", no_argument, NULL, 'o'},
+		{"record", required_argument, NULL, 'r'},
+		{"replay", required_argument, NULL, 'p'},
+		{"realtime", no_argument, NULL, 't'},
+		{"save-profile", required_argument, NULL, 'S'},
+		{"load-profile", required_argument, NULL, 'L'},
+		{"raise-key", required_argument, NULL, 'R'},
+		{"lower-key", required_argument, NULL, 'W'},
+		{"mute-key", required_argument, NULL, 'M'},
+		{"hotkeys", no_argument, NULL, 'k'},
+		{"headless", no_argument, NULL, 'H'},
+		{"control", optional_argument, NULL, 'c'},
+		{"window", required_argument, NULL, 'w'},
+		{"server", required_argument, NULL, 'a'},
+		{"max-fps", required_argument, NULL, 'f'},
+		{"monitor", no_argument, NULL, 'm'},
+		{NULL, 0, NULL, 0}
+	};
+
+	window_filters = WMCreateArray(0);
+	server_addresses = WMCreateArray(0);
+	while ((opt = getopt_long(argc, argv, "hv", long_options,
+				  NULL)) != -1) {
+		switch (opt) {
+		case 'h':
+			print_help(argv[0]);
+			exit(EXIT_SUCCESS);
+
+		case 'v':
+			printf("%s\n", PACKAGE_STRING);
+			exit(EXIT_SUCCESS);
+
+		case 's':
+			setup_stats(optarg);
+			break;
+
+		case 'o':
+			stats_overlay = True;
+			break;
+
+		case 'r':
+			setup_trace_recording(optarg);
+			break;
+
+		case 'p':
+			replay_file = optarg;
+			break;
+
+		case 't':
+			replay_realtime = True;
+			break;
+
+		case 'S':
+			save = optarg;
+			break;
+
+		case 'L':
+			load = optarg;
+			break;
+
+		case 'R':
+			hotkey_keysyms[HOTKEY_RAISE] = optarg;
+			break;
+
+		case 'W':
+			hotkey_keysyms[HOTKEY_LOWER] = optarg;
+			break;
+
+		case 'M':
+			hotkey_keysyms[HOTKEY_MUTE] = optarg;
+			break;
+
+		case 'k':
+			use_hotkeys = True;
+			break;
+
+		case 'H':
+			headless = True;
+			break;
+
+		case 'c':
+			use_control = True;
+			control_path = optarg;
+			break;
+
+		case 'w':
+			WMAddToArray(window_filters, optarg);
+			break;
+
+		case 'a':
+			WMAddToArray(server_addresses, optarg);
+			break;
+
+		case 'f':
+			max_fps = atoi(optarg);
+			if (max_fps < 0) {
+				werror("--max-fps must not be negative");
+				exit(EXIT_FAILURE);
+			}
+			break;
+
+		case 'm':
+			monitor = True;
+			break;
+
+		default:
+			print_help(argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	/* the overlay has nothing to show unless statistics are collected */
+	if (stats_overlay && !stats_available()) {
+		setup_stats(NULL);
+		if (!stats_available()) {
+			wwarning("ignoring --stats-overlay");
+			stats_overlay = False;
+		}
+	}
+
+	set_profile_action(save, load);
 }
 
-int y_to_bar(int y)
+void print_help(const char *prog)
 {
-	int result;
-
-	result = (SLIDER_HEIGHT - 2 - y) / 2;
-	if (result < 0)
-		return 0;
-	else if (result > 25)
-		return 25;
-	else
-		return result;
+	printf("Usage: %s [OPTIONS]\n", prog);
+	printf("PulseAudio mixer as a Window Maker dockapp\n\n");
+	printf("  -h, --help          show this help text and exit\n");
+	printf("  -v, --version       show version and exit\n");
+	printf("      --stats[=FILE]  collect performance counters and dump "
+	       "them as JSON\n"
+	       "                      to FILE (default stderr) on "
+	       "SIGUSR1\n");
+	printf("      --stats-overlay show the mean server round trip (ms) "
+	       "over the icon,\n"
+	       "                      collecting statistics as --stats "
+	       "does\n");
+	printf("      --record=FILE   record server replies and input events "
+	       "to FILE\n");
+	printf("      --replay=FILE   replay a recorded trace without a "
+	       "server, report\n"
+	       "                      timings and exit\n");
+	printf("      --realtime      replay at the recorded pace instead "
+	       "of as fast as\n"
+	       "                      possible\n");
+	printf("      --save-profile=NAME\n"
+	       "                      save every device's volume and mute "
+	       "state and the\n"
+	       "                      default sink and source as NAME, "
+	       "then exit\n");
+	printf("      --load-profile=NAME\n"
+	       "                      restore the profile NAME, then exit\n");
+	printf("      --raise-key=KEY key that raises the volume (default "
+	       "XF86AudioRaiseVolume)\n");
+	printf("      --lower-key=KEY key that lowers the volume (default "
+	       "XF86AudioLowerVolume)\n");
+	printf("      --mute-key=KEY  key that toggles mute (default "
+	       "XF86AudioMute)\n");
+	printf("      --hotkeys       grab the volume keys, so they work "
+	       "whichever window\n"
+	       "                      has focus\n");
+	printf("      --headless      run without X, controlled only "
+	       "through the control\n"
+	       "                      socket\n");
+	printf("      --control[=PATH]\n"
+	       "                      accept commands on a Unix socket "
+	       "(default\n"
+	       "                      $XDG_RUNTIME_DIR/wmpmixer.sock)\n");
+	printf("      --window=FILTER open a dockapp showing only the "
+	       "devices FILTER\n"
+	       "                      matches: sinks, sources, streams, "
+	       "recordings, apps,\n"
+	       "                      all or app:NAME (may be given more "
+	       "than once)\n");
+	printf("      --server=ADDRESS\n"
+	       "                      connect to the PulseAudio server at "
+	       "ADDRESS instead of\n"
+	       "                      the default one (may be given more "
+	       "than once)\n");
+	printf("      --max-fps=N     repaint at most N times a second "
+	       "(default 60, 0 for\n"
+	       "                      no limit)\n");
+	printf("      --monitor       sample every device's latency, and "
+	       "show the worst\n"
+	       "                      ones over the icon\n");
 }
@@ -20,11 +20,34 @@
 #ifndef WMPMIXER_H
 #define WMPMIXER_H
 
-#include <WINGs/WINGs.h>
+#include <WINGs/WUtil.h>
 
-WMScreen *get_screen(void);
-void update_device(void);
-void update_slider(void);
-void update_muted(void);
+#include "hotkeys.h"
+#include "pulse.h"
+
+/* the windows, loaded from a module only when there are any to show */
+typedef struct {
+	int (*run)(int argc, char **argv);
+	void (*update_dockapps)(void);
+	void (*update_slider)(PulseDevice *device);
+	void (*update_muted)(PulseDevice *device);
+} DockappModule;
+
+/* the command line, as the module needs it */
+extern WMArray *window_filters;
+extern Bool stats_overlay;
+extern Bool monitor;
+extern char *replay_file;
+extern Bool replay_realtime;
+extern Bool use_hotkeys;
+extern const char *hotkey_keysyms[HOTKEY_COUNT];
+extern Bool use_control;
+extern char *control_path;
+extern int max_fps;
+
+void add_servers(void);
+void update_dockapps(void);
+void update_slider(PulseDevice *device);
+void update_muted(PulseDevice *device);
 
 #endif